@@ -0,0 +1,700 @@
+#include "Commands.h"
+#include "Replication.h"
+#include <sstream>
+#include <stdexcept>
+#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+void printHelp(struct OutputBuffer* out) {
+    std::ostringstream help;
+    help << "\nAvailable Commands:\n";
+    help << "====================================================================================================\n";
+    help << std::left;
+    help << std::setw(55) << "Общие команды:" << "Описание:" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  HELP" << "Показать это справочное сообщение." << "\n";
+    help << std::setw(55) << "  QUIT" << "Выйти из программы." << "\n";
+    help << std::setw(55) << "  BGSAVE" << "Сохранить снимок в фоновом процессе." << "\n";
+    help << std::setw(55) << "  STATS" << "Показать состояние хранилища и сохранения." << "\n";
+    help << std::setw(55) << "  PROFILE <name> [RESET]" << "Счётчики операций структуры (сборка с -DSTORE_PROFILE)." << "\n";
+    help << std::setw(55) << "  SYNC" << "Подключить реплику: снимок и поток изменений (сервер)." << "\n";
+    help << std::setw(55) << "  <X>CREATE <name>" << "Создать новую структуру данных. X: M, F, L, S, Q, T, B, H, P, V." << "\n";
+    help << std::setw(55) << "  PRINT <name> [OFFSET n] [LIMIT m]" << "Напечатать содержимое структуры (или его часть)." << "\n";
+    help << std::setw(55) << "  SCAN <name> <cursor> [COUNT k]" << "Постраничный обход: следующий курсор и до k элементов." << "\n";
+    help << std::setw(55) << "  ISMEMBER <name> <value>" << "Проверить, есть ли значение в структуре (не для S, Q)." << "\n";
+    help << std::setw(55) << "  COUNT <name> <value>" << "Сколько раз значение встречается в M, F или L." << "\n";
+    help << std::setw(55) << "  FIND_ALL <name> <value>" << "Номера всех вхождений значения в M, F или L." << "\n";
+
+    help << "\n" << std::setw(55) << "Динамический массив (M - DynamicArray):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  MPUSH_BACK <name> <value> [value...]" << "Добавить элементы в конец." << "\n";
+    help << std::setw(55) << "  MINSERT_AT <name> <index> <value>" << "Вставить элемент по индексу." << "\n";
+    help << std::setw(55) << "  MSET_AT <name> <index> <value>" << "Заменить элемент по индексу." << "\n";
+    help << std::setw(55) << "  MGET <name> <index>" << "Получить элемент по индексу." << "\n";
+    help << std::setw(55) << "  MGET_RANGE <name> <from> <to>" << "Получить элементы с from по to включительно." << "\n";
+    help << std::setw(55) << "  MDEL_AT <name> <index>" << "Удалить элемент по индексу." << "\n";
+    help << std::setw(55) << "  MLENGTH <name>" << "Получить размер массива." << "\n";
+    help << std::setw(55) << "  MRESERVE <name> <capacity>" << "Заранее выделить место; ниже этой ёмкости массив не сжимается." << "\n";
+    help << std::setw(55) << "  MSORT <name>" << "Отсортировать массив; дальше поиск в нём двоичный." << "\n";
+    help << std::setw(55) << "  MLOWER_BOUND <name> <value>" << "Индекс первого элемента >= value (только после MSORT)." << "\n";
+
+    help << "\n" << std::setw(55) << "Односвязный/Двусвязный список (F/L - FList/LList):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  <X>PUSH_HEAD <name> <value>" << "Добавить элемент в начало." << "\n";
+    help << std::setw(55) << "  <X>PUSH_TAIL <name> <value>" << "Добавить элемент в конец." << "\n";
+    help << std::setw(55) << "  <X>INS_BEFORE <name> <target_val> <new_val>" << "Вставить элемент перед указанным значением." << "\n";
+    help << std::setw(55) << "  <X>INS_AFTER <name> <target_val> <new_val>" << "Вставить элемент после указанного значения." << "\n";
+    help << std::setw(55) << "  <X>GET_HEAD <name>" << "Получить первый элемент." << "\n";
+    help << std::setw(55) << "  <X>GET_TAIL <name>" << "Получить последний элемент." << "\n";
+    help << std::setw(55) << "  <X>GET_AT <name> <index>" << "Получить элемент по индексу." << "\n";
+    help << std::setw(55) << "  <X>DEL_HEAD <name>" << "Удалить первый элемент." << "\n";
+    help << std::setw(55) << "  <X>DEL_TAIL <name>" << "Удалить последний элемент." << "\n";
+    help << std::setw(55) << "  <X>DEL_BY_VALUE <name> <value>" << "Удалить первое вхождение значения." << "\n";
+    help << std::setw(55) << "  <X>DEL_BEFORE <name> <value>" << "Удалить элемент перед указанным значением." << "\n";
+    help << std::setw(55) << "  <X>DEL_AFTER <name> <value>" << "Удалить элемент после указанного значения." << "\n";
+
+    help << "\n" << std::setw(55) << "Стек (S - Stack):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  SPUSH <name> <value> [value...]" << "Положить элементы в стек." << "\n";
+    help << std::setw(55) << "  SPOP <name> [count]" << "Извлечь элемент (или count элементов) из стека." << "\n";
+    help << std::setw(55) << "  SPEAK <name>" << "Посмотреть верхний элемент." << "\n";
+    help << std::setw(55) << "  SLENGTH <name>" << "Получить размер стека." << "\n";
+
+    help << "\n" << std::setw(55) << "Очередь (Q - Queue):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  QPUSH <name> <value> [value...]" << "Добавить элементы в очередь." << "\n";
+    help << std::setw(55) << "  QPOP <name> [count]" << "Извлечь элемент (или count элементов) из очереди." << "\n";
+    help << std::setw(55) << "  QPEEK <name>" << "Посмотреть первый элемент." << "\n";
+    help << std::setw(55) << "  QLENGTH <name>" << "Получить размер очереди." << "\n";
+
+    help << "\n" << std::setw(55) << "АВЛ-Дерево (T - Tree):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  TINSERT <name> <value> [value...]" << "Вставить элементы." << "\n";
+    help << std::setw(55) << "  TDEL <name> <value>" << "Удалить элемент." << "\n";
+    help << std::setw(55) << "  TGET <name> <value>" << "Найти и показать элемент, если он существует." << "\n";
+    help << std::setw(55) << "  TUNION <dst> <a> <b>" << "Записать в dst объединение деревьев a и b." << "\n";
+    help << std::setw(55) << "  TINTERSECT <dst> <a> <b>" << "Записать в dst пересечение деревьев a и b." << "\n";
+    help << std::setw(55) << "  TDIFF <dst> <a> <b>" << "Записать в dst элементы a, которых нет в b." << "\n";
+
+    help << "\n" << std::setw(55) << "B+-дерево (B - BTree):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  BINSERT <name> <value> [value...]" << "Вставить элементы." << "\n";
+    help << std::setw(55) << "  BDEL <name> <value>" << "Удалить элемент." << "\n";
+    help << std::setw(55) << "  BGET <name> <value>" << "Найти и показать элемент, если он существует." << "\n";
+    help << std::setw(55) << "  BRANGE <name> <from> <to>" << "Элементы в диапазоне [from, to] по возрастанию." << "\n";
+    help << std::setw(55) << "  BLENGTH <name>" << "Получить количество элементов." << "\n";
+
+    help << "\n" << std::setw(55) << "Хеш-множество (H - HashSet):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  HADD <name> <value> [value...]" << "Добавить элементы." << "\n";
+    help << std::setw(55) << "  HDEL <name> <value>" << "Удалить элемент." << "\n";
+    help << std::setw(55) << "  HIS_MEMBER <name> <value>" << "Проверить, есть ли элемент в множестве." << "\n";
+    help << std::setw(55) << "  HLENGTH <name>" << "Получить количество элементов." << "\n";
+
+    help << "\n" << std::setw(55) << "Очередь с приоритетом (P - PQueue):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  PPUSH <name> <value> [value...]" << "Добавить элементы." << "\n";
+    help << std::setw(55) << "  PPOP <name> [count]" << "Извлечь наименьший элемент (или count наименьших)." << "\n";
+    help << std::setw(55) << "  PPEEK <name>" << "Посмотреть наименьший элемент." << "\n";
+    help << std::setw(55) << "  PTOPK <name> <k>" << "k наименьших элементов по возрастанию, без извлечения." << "\n";
+    help << std::setw(55) << "  PLENGTH <name>" << "Получить количество элементов." << "\n";
+
+    help << "\n" << std::setw(55) << "Персистентное АВЛ-дерево (V - VTree):" << "\n";
+    help << "----------------------------------------------------------------------------------------------------\n";
+    help << std::setw(55) << "  VINSERT <name> <value> [value...]" << "Вставить элементы." << "\n";
+    help << std::setw(55) << "  VDEL <name> <value>" << "Удалить элемент." << "\n";
+    help << std::setw(55) << "  VGET <name> <value>" << "Найти и показать элемент, если он существует." << "\n";
+    help << std::setw(55) << "  VRANGE <name> <from> <to>" << "Элементы в диапазоне [from, to] по возрастанию." << "\n";
+    help << std::setw(55) << "  VLENGTH <name>" << "Получить количество элементов." << "\n";
+    help << "====================================================================================================\n";
+    if (out->format == TEXT_FORMAT) writeRaw(out, help.str());
+    else replyValue(out, help.str());
+}
+
+bool nextArg(struct CommandArgs* args, std::string& value) {
+    if (args->position >= args->tokens->size()) return false;
+    value = (*args->tokens)[args->position++];
+    return true;
+}
+
+// Значение, которое будет сохранено в структуре: из отданных токенов - перемещением, иначе копией.
+bool takeArg(struct CommandArgs* args, std::string& value) {
+    if (args->owned == nullptr) return nextArg(args, value);
+    if (args->position >= args->owned->size()) return false;
+    value = std::move((*args->owned)[args->position++]);
+    return true;
+}
+
+size_t remainingArgs(const struct CommandArgs* args) {
+    return args->tokens->size() - args->position;
+}
+
+int64_t parseCount(const std::string& value) {
+    int64_t count = std::stoll(value);
+    if (count < 0) throw std::out_of_range("Invalid count.");
+    return count;
+}
+
+// Токены строятся прямо в векторе из подстрок line - без промежуточного потока и копий.
+void splitCommandLine(const std::string& line, std::vector<std::string>* tokens) {
+    tokens->clear();
+    size_t position = 0;
+    while (position < line.size()) {
+        while (position < line.size() && std::isspace(static_cast<unsigned char>(line[position]))) position++;
+        size_t start = position;
+        while (position < line.size() && !std::isspace(static_cast<unsigned char>(line[position]))) position++;
+        if (position > start) tokens->emplace_back(line, start, position - start);
+    }
+}
+
+// PRINT <name> [OFFSET n] [LIMIT m] и SCAN <name> <cursor> [COUNT k]. Курсор SCAN - номер
+// следующего элемента; 0 в ответе означает, что обход завершён.
+static void parsePageRequest(const std::string& command, struct CommandArgs* args, struct PageRequest* page) {
+    std::string keyword, value;
+    page->isScan = command == "SCAN";
+    page->offset = 0;
+    page->limit = page->isScan ? SCAN_DEFAULT_COUNT : std::numeric_limits<int64_t>::max();
+    if (page->isScan) {
+        if (!nextArg(args, value)) throw CommandError(ERR_SYNTAX, "Нет курсора.");
+        page->offset = parseCount(value);
+    }
+    while (nextArg(args, keyword)) {
+        if (!nextArg(args, value)) throw CommandError(ERR_SYNTAX, "Нет значения для " + keyword + ".");
+        if (!page->isScan && keyword == "OFFSET") page->offset = parseCount(value);
+        else if (!page->isScan && keyword == "LIMIT") page->limit = parseCount(value);
+        else if (page->isScan && keyword == "COUNT") page->limit = std::max<int64_t>(1, parseCount(value));
+        else throw CommandError(ERR_SYNTAX, "Неизвестный параметр " + keyword + ".");
+    }
+}
+
+static void replyPositions(struct OutputBuffer* out, const std::vector<int64_t>& positions) {
+    replyArrayBegin(out, positions.size());
+    for (int64_t position : positions) replyArrayItem(out, std::to_string(position));
+    replyArrayEnd(out);
+}
+
+// Ответ SCAN - пара [следующий курсор, элементы]; в текстовом режиме курсор идёт отдельной строкой.
+static void replyScanCursor(struct OutputBuffer* out, const struct PageRequest& page, long long length) {
+    // COUNT задаёт клиент: сравниваем с остатком, чтобы offset + limit не переполнился.
+    bool finished = page.offset >= length || page.limit >= length - page.offset;
+    replyArrayBegin(out, 2);
+    replyInteger(out, finished ? 0 : static_cast<long long>(page.offset + page.limit));
+}
+
+// В текстовом режиме - строка "key: value", в остальных - пара ключ/значение ответа-словаря.
+static void replyStat(struct OutputBuffer* out, const std::string& key, const std::string& value) {
+    if (out->format == TEXT_FORMAT) {
+        writeRaw(out, key + ": " + value + "\n");
+        return;
+    }
+    replyValue(out, key);
+    replyValue(out, value);
+}
+
+static void replyStat(struct OutputBuffer* out, const std::string& key, long long value) {
+    if (out->format == TEXT_FORMAT) {
+        replyStat(out, key, std::to_string(value));
+        return;
+    }
+    replyValue(out, key);
+    replyInteger(out, value);
+}
+
+// PRINT и SCAN неизменённой структуры отдаются из её кэша. При промахе ответ пишется как обычно,
+// а копия снимается через beginCapture/endCapture. Страницы, в которых заведомо больше PRINT_CACHE_BUDGET байт
+// (на элемент уходит хотя бы два байта), не копируются вовсе.
+template <typename Render>
+static void replyPage(struct DataStore* store, struct StoreEntry* entry, const struct PageRequest& page, long long length, struct OutputBuffer* out, Render render) {
+    const std::string* cached = findPrintCache(store, entry, out->format, page.isScan, page.offset, page.limit);
+    if (cached) {
+        writeRaw(out, *cached);
+        return;
+    }
+    long long items = std::min<long long>(page.limit, std::max<long long>(0, length - page.offset));
+    if (items > PRINT_CACHE_BUDGET / 2) {
+        render();
+        return;
+    }
+    std::string reply = std::move(entry->printCache.reply);
+    reply.clear();
+    releasePrintCache(entry);
+    beginCapture(out, &reply, PRINT_CACHE_BUDGET);
+    try {
+        render();
+    } catch (...) {
+        endCapture(out);
+        throw;
+    }
+    if (endCapture(out)) storePrintCache(store, entry, out->format, page.isScan, page.offset, page.limit, std::move(reply));
+}
+
+static void replyStats(struct DataStore* store, struct OutputBuffer* out) {
+    const struct BackgroundSave* background = &store->background;
+    static const char* statusNames[] = {"none", "ok", "failed"};
+    int structures = store->count;
+    for (int i = 0; i < store->shardCount; ++i) structures += store->shards[i].count;
+    const struct ReplicationState* replication = &store->replication;
+    const char* link = "none";
+    int64_t lag = 0;
+    if (replication->follower) {
+        link = replication->leaderFd >= 0 ? "up" : "down";
+        // Пока связи нет, отставание растёт со временем с последней записи ведущего.
+        lag = replication->leaderFd >= 0 ? replication->lagMs : std::max<int64_t>(0, replicationClock() - replication->leaderTime);
+    }
+    if (out->format != TEXT_FORMAT) replyMapBegin(out, 12);
+    replyStat(out, "structures", structures);
+    replyStat(out, "shards", store->shardCount);
+    replyStat(out, "bgsave_in_progress", background->child > 0 ? 1 : 0);
+    replyStat(out, "last_bgsave_status", statusNames[background->lastStatus]);
+    replyStat(out, "last_bgsave_duration_ms", background->lastDurationMs);
+    replyStat(out, "changes_since_save", background->pendingChanges);
+    replyStat(out, "autosave_changes", background->autoSaveChanges);
+    replyStat(out, "replication_role", replication->follower ? "follower" : "leader");
+    replyStat(out, "replication_link", link);
+    replyStat(out, "replication_offset", static_cast<long long>(replication->offset));
+    replyStat(out, "replication_lag_ms", lag);
+    replyStat(out, "connected_replicas", replication->replicaCount);
+}
+
+static long long entryLength(const struct StoreEntry* entry) {
+    switch (entry->type) {
+        case ARRAY_TYPE: return MLENGTH(static_cast<DynamicArray*>(entry->dataPtr));
+        case FLIST_TYPE: return static_cast<SinglyLinkedList*>(entry->dataPtr)->length;
+        case LLIST_TYPE: return static_cast<DoublyLinkedList*>(entry->dataPtr)->length;
+        case STACK_TYPE: return SLENGTH(static_cast<Stack*>(entry->dataPtr));
+        case QUEUE_TYPE: return QLENGTH(static_cast<Queue*>(entry->dataPtr));
+        case TREE_TYPE: return TLENGTH(static_cast<AVLTree*>(entry->dataPtr));
+        case BTREE_TYPE: return BLENGTH(static_cast<BPlusTree*>(entry->dataPtr));
+        case HSET_TYPE: return HLENGTH(static_cast<HashSet*>(entry->dataPtr));
+        case PQUEUE_TYPE: return PLENGTH(static_cast<PriorityQueue*>(entry->dataPtr));
+        case VTREE_TYPE: return VLENGTH(static_cast<VersionedTree*>(entry->dataPtr));
+        default: return 0;
+    }
+}
+
+static uint64_t parseSectionIndex(const std::string& value, const struct SectionView* view) {
+    long long index = std::stoll(value);
+    if (index < 0 || static_cast<uint64_t>(index) >= view->count) throw std::out_of_range("Invalid index.");
+    return static_cast<uint64_t>(index);
+}
+
+// Режим --readonly: ответы строятся прямо по отображённым байтам снимка, структуры не создаются.
+static void executeSnapshotQuery(struct DataStore* store, const std::string& command, struct CommandArgs* args, struct OutputBuffer* out) {
+    std::string name, arg1, arg2;
+    if ((command.length() == 7 && command.substr(1) == "CREATE") || isTreeSetCommand(command)) throw CommandError(ERR_READ_ONLY, "Хранилище открыто только для чтения.");
+    if (!nextArg(args, name)) throw CommandError(ERR_SYNTAX, "Отсутствует имя структуры для команды '" + command + "'.");
+    struct StoreEntry* entry = findEntry(store, name);
+    if (!entry) throw CommandError(ERR_NO_SUCH_STRUCTURE, "Структура '" + name + "' не найдена.");
+    struct SectionView view;
+    if (!entrySectionView(store, entry, &view)) throw std::runtime_error("Corrupted snapshot section.");
+    enum StructureType type = entry->type;
+    bool isList = (type == FLIST_TYPE && command[0] == 'F') || (type == LLIST_TYPE && command[0] == 'L');
+    std::string op = command.substr(1);
+
+    if (command == "PRINT" || command == "SCAN") {
+        struct PageRequest page;
+        parsePageRequest(command, args, &page);
+        replyPage(store, entry, page, static_cast<long long>(view.count), out, [&]() {
+            if (page.isScan) replyScanCursor(out, page, static_cast<long long>(view.count));
+            printSection(&view, type == STACK_TYPE, static_cast<uint64_t>(page.offset), static_cast<uint64_t>(page.limit), out);
+        });
+        return;
+    }
+    bool sorted = type == TREE_TYPE || type == BTREE_TYPE || type == VTREE_TYPE || ((type == ARRAY_TYPE || type == HSET_TYPE) && (entry->sectionFlags & SNAPSHOT_FLAG_SORTED));
+    if (command == "ISMEMBER") {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Отсутствует значение для ISMEMBER.");
+        if (sorted) replyBool(out, sectionSortedContains(&view, arg1));
+        else if (type == ARRAY_TYPE || type == FLIST_TYPE || type == LLIST_TYPE || type == HSET_TYPE) replyBool(out, sectionContains(&view, arg1));
+        else throw CommandError(ERR_WRONG_TYPE, "ISMEMBER не поддерживается для этого типа.");
+        return;
+    }
+    if (command == "COUNT" || command == "FIND_ALL") {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Отсутствует значение для " + command + ".");
+        if (type != ARRAY_TYPE && type != FLIST_TYPE && type != LLIST_TYPE) throw CommandError(ERR_WRONG_TYPE, command + " не поддерживается для этого типа.");
+        if (command == "COUNT") {
+            replyInteger(out, sectionFind(&view, arg1, SCAN_ALL, nullptr).matches);
+        } else {
+            std::vector<int64_t> positions;
+            sectionFind(&view, arg1, SCAN_ALL, &positions);
+            replyPositions(out, positions);
+        }
+        return;
+    }
+    if ((type == ARRAY_TYPE && command == "MLENGTH") || (type == STACK_TYPE && command == "SLENGTH") || (type == QUEUE_TYPE && command == "QLENGTH") || (type == BTREE_TYPE && command == "BLENGTH") || (type == HSET_TYPE && command == "HLENGTH") || (type == PQUEUE_TYPE && command == "PLENGTH") || (type == VTREE_TYPE && command == "VLENGTH")) {
+        replyInteger(out, static_cast<long long>(view.count));
+        return;
+    }
+    if (type == ARRAY_TYPE && command == "MLOWER_BOUND") {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Нет значения.");
+        if (!sorted) throw std::logic_error("Array is not sorted.");
+        replyInteger(out, static_cast<long long>(sectionLowerBound(&view, arg1)));
+        return;
+    }
+    if (type == ARRAY_TYPE && command == "MGET") {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Нет индекса.");
+        replyValue(out, sectionValue(&view, parseSectionIndex(arg1, &view)));
+        return;
+    }
+    if (type == ARRAY_TYPE && command == "MGET_RANGE") {
+        if (!(nextArg(args, arg1) && nextArg(args, arg2))) throw CommandError(ERR_SYNTAX, "Нет диапазона.");
+        long long from = std::stoll(arg1), to = std::stoll(arg2);
+        if (from < 0 || to < from) throw std::out_of_range("Invalid range.");
+        if (static_cast<uint64_t>(to) >= view.count) to = static_cast<long long>(view.count) - 1;
+        replyArrayBegin(out, from <= to ? static_cast<size_t>(to - from + 1) : 0);
+        for (long long i = from; i <= to; ++i) replyArrayItem(out, sectionValue(&view, static_cast<uint64_t>(i)));
+        replyArrayEnd(out);
+        return;
+    }
+    if (isList && (op == "GET_HEAD" || op == "GET_TAIL" || op == "GET_AT")) {
+        uint64_t index = 0;
+        if (op == "GET_AT") {
+            if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Нет индекса.");
+            index = parseSectionIndex(arg1, &view);
+        } else {
+            if (view.count == 0) throw std::underflow_error(type == FLIST_TYPE ? "Singly Linked List is empty." : "Doubly Linked List is empty.");
+            if (op == "GET_TAIL") index = view.count - 1;
+        }
+        replyValue(out, sectionValue(&view, index));
+        return;
+    }
+    if ((type == STACK_TYPE && command == "SPEAK") || (type == QUEUE_TYPE && command == "QPEEK") || (type == PQUEUE_TYPE && command == "PPEEK")) {
+        if (view.count == 0) throw std::underflow_error(type == STACK_TYPE ? "Stack is empty." : type == QUEUE_TYPE ? "Queue is empty." : "Priority Queue is empty.");
+        replyValue(out, sectionValue(&view, type == STACK_TYPE ? view.count - 1 : 0));
+        return;
+    }
+    if (type == HSET_TYPE && command == "HIS_MEMBER") {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Нет значения.");
+        // Линейный проход остаётся только для снимков, записанных до сортировки секций HSET.
+        replyBool(out, sorted ? sectionSortedContains(&view, arg1) : sectionContains(&view, arg1));
+        return;
+    }
+    if ((type == TREE_TYPE && command == "TGET") || (type == BTREE_TYPE && command == "BGET") || (type == VTREE_TYPE && command == "VGET")) {
+        if (!nextArg(args, arg1)) throw CommandError(ERR_SYNTAX, "Нет значения.");
+        if (sectionSortedContains(&view, arg1)) replyValue(out, arg1); else replyNotFound(out);
+        return;
+    }
+    throw CommandError(ERR_READ_ONLY, "Команда '" + command + "' недоступна в режиме только для чтения.");
+}
+
+// Пока команда выполняется, операции структуры считаются в её счётчики (см. PROFILE_COUNT).
+struct CounterScope {
+    explicit CounterScope(struct OpCounters* counters) {
+        activeCounters = counters;
+        PROFILE_COUNT(operations, 1);
+    }
+    ~CounterScope() {
+        activeCounters = nullptr;
+    }
+};
+
+static void replyProfile(const struct OpCounters* counters, struct OutputBuffer* out) {
+    if (out->format != TEXT_FORMAT) replyMapBegin(out, 6);
+    replyStat(out, "operations", static_cast<long long>(counters->operations));
+    replyStat(out, "comparisons", static_cast<long long>(counters->comparisons));
+    replyStat(out, "nodes_visited", static_cast<long long>(counters->nodesVisited));
+    replyStat(out, "rotations", static_cast<long long>(counters->rotations));
+    replyStat(out, "resizes", static_cast<long long>(counters->resizes));
+    replyStat(out, "bytes_copied", static_cast<long long>(counters->bytesCopied));
+}
+
+bool isTreeSetCommand(const std::string& command) {
+    return command == "TUNION" || command == "TINTERSECT" || command == "TDIFF";
+}
+
+// С --shards структура лежит в шарде своего имени. Команды над несколькими структурами
+// выполняются в основном потоке, пока шарды стоят, поэтому им доступен любой шард.
+static struct DataStore* storeForName(struct DataStore* store, const std::string& name) {
+    return store->shardCount > 0 ? &store->shards[shardForName(name, store->shardCount)] : store;
+}
+
+static const struct AVLTree* findTreeOperand(struct DataStore* store, const std::string& name) {
+    struct StoreEntry* entry = findEntry(storeForName(store, name), name);
+    if (!entry) throw CommandError(ERR_NO_SUCH_STRUCTURE, "Структура '" + name + "' не найдена.");
+    if (entry->type != TREE_TYPE) throw CommandError(ERR_WRONG_TYPE, "Структура '" + name + "' не является деревом T.");
+    return static_cast<AVLTree*>(entry->dataPtr);
+}
+
+// TUNION/TINTERSECT/TDIFF dst a b: dst создаётся или перезаписывается (как при TCREATE), ответ - его размер.
+static void executeTreeSetCommand(struct DataStore* store, const std::string& command, struct CommandArgs* args, struct OutputBuffer* out) {
+    std::string name, first, second;
+    if (!(nextArg(args, name) && nextArg(args, first) && nextArg(args, second))) throw CommandError(ERR_SYNTAX, "Ожидалось " + command + " <dst> <a> <b>.");
+    const struct AVLTree* a = findTreeOperand(store, first);
+    const struct AVLTree* b = findTreeOperand(store, second);
+    struct DataStore* target = storeForName(store, name);
+    struct StoreEntry* entry = findEntry(target, name);
+    if (!entry || entry->type != TREE_TYPE) {
+        createAndAddStructure(target, name, TREE_TYPE);
+        entry = findEntry(target, name);
+    }
+    struct CounterScope counterScope(&entry->counters);
+    markEntryModified(entry);
+    struct AVLTree* dst = static_cast<AVLTree*>(entry->dataPtr);
+    if (command == "TUNION") TUNION(dst, a, b);
+    else if (command == "TINTERSECT") TINTERSECT(dst, a, b);
+    else TDIFF(dst, a, b);
+    replyInteger(out, TLENGTH(dst));
+}
+
+// Ведомый принимает от клиентов только чтение; запись приходит лишь из потока ведущего.
+bool isWriteCommand(const std::string& command) {
+    if (command.length() == 7 && command.substr(1) == "CREATE") return true;
+    if (isTreeSetCommand(command)) return true;
+    static const char* const markers[] = {"PUSH", "INS", "SET_AT", "DEL", "POP", "ADD", "SORT"};
+    for (const char* marker : markers) {
+        if (command.find(marker) != std::string::npos) return true;
+    }
+    return false;
+}
+
+static bool executeArgs(struct DataStore* store, struct CommandArgs args, struct OutputBuffer* out) {
+    std::string command, name, arg1, arg2;
+    nextArg(&args, command);
+
+    if (command == "HELP") {
+        printHelp(out);
+        return false;
+    }
+
+    if (command == "STATS") {
+        pollBackgroundSave(store, store->filePath, false);
+        replyStats(store, out);
+        return false;
+    }
+
+    try {
+        if (command == "BGSAVE") {
+            if (store->readOnly) throw CommandError(ERR_READ_ONLY, "Хранилище открыто только для чтения.");
+            if (!startBackgroundSave(store, store->filePath)) throw CommandError(ERR_FAILED, "Фоновое сохранение уже выполняется или не может быть запущено.");
+            replyOK(out);
+            return false;
+        }
+
+        if (store->readOnly) {
+            executeSnapshotQuery(store, command, &args, out);
+            return false;
+        }
+
+        if (command.length() == 7 && command.substr(1) == "CREATE") {
+            if (!nextArg(&args, name)) throw CommandError(ERR_SYNTAX, "Отсутствует имя для CREATE.");
+            StructureType type = NONE_TYPE;
+            char typeChar = command[0];
+            if (typeChar == 'M') type = ARRAY_TYPE;
+            else if (typeChar == 'F') type = FLIST_TYPE;
+            else if (typeChar == 'L') type = LLIST_TYPE;
+            else if (typeChar == 'S') type = STACK_TYPE;
+            else if (typeChar == 'Q') type = QUEUE_TYPE;
+            else if (typeChar == 'T') type = TREE_TYPE;
+            else if (typeChar == 'B') type = BTREE_TYPE;
+            else if (typeChar == 'H') type = HSET_TYPE;
+            else if (typeChar == 'P') type = PQUEUE_TYPE;
+            else if (typeChar == 'V') type = VTREE_TYPE;
+            else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестный тип структуры для CREATE.");
+            createAndAddStructure(store, name, type);
+            replyOK(out);
+            return true;
+        }
+
+        if (isTreeSetCommand(command)) {
+            executeTreeSetCommand(store, command, &args, out);
+            return true;
+        }
+
+        if (!nextArg(&args, name)) throw CommandError(ERR_SYNTAX, "Отсутствует имя структуры для команды '" + command + "'.");
+        struct StoreEntry* entry = findEntry(store, name);
+        if (!entry) throw CommandError(ERR_NO_SUCH_STRUCTURE, "Структура '" + name + "' не найдена.");
+
+        if (command == "PROFILE") {
+#ifndef STORE_PROFILE
+            throw CommandError(ERR_FAILED, "Счётчики операций выключены: соберите с -DSTORE_PROFILE.");
+#endif
+            if (nextArg(&args, arg1)) {
+                std::transform(arg1.begin(), arg1.end(), arg1.begin(), [](unsigned char c) { return std::toupper(c); });
+                if (arg1 != "RESET") throw CommandError(ERR_SYNTAX, "Ожидалось PROFILE <name> [RESET].");
+                entry->counters = OpCounters();
+                replyOK(out);
+            } else {
+                replyProfile(&entry->counters, out);
+            }
+            return false;
+        }
+        struct CounterScope counterScope(&entry->counters);
+        if (isWriteCommand(command)) markEntryModified(entry);
+
+        // Общие команды
+        if (command == "PRINT" || command == "SCAN") {
+            struct PageRequest page;
+            parsePageRequest(command, &args, &page);
+            replyPage(store, entry, page, entryLength(entry), out, [&]() {
+                if (page.isScan) replyScanCursor(out, page, entryLength(entry));
+                switch (entry->type) {
+                    case ARRAY_TYPE: MPRINT_PAGE(static_cast<DynamicArray*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case FLIST_TYPE: FPRINT_PAGE(static_cast<SinglyLinkedList*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case LLIST_TYPE: LPRINT_PAGE(static_cast<DoublyLinkedList*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case STACK_TYPE: SPRINT_PAGE(static_cast<Stack*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case QUEUE_TYPE: QPRINT_PAGE(static_cast<Queue*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case TREE_TYPE: TPRINT_PAGE(static_cast<AVLTree*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case BTREE_TYPE: BPRINT_PAGE(static_cast<BPlusTree*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case HSET_TYPE: HPRINT_PAGE(static_cast<HashSet*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case PQUEUE_TYPE: PPRINT_PAGE(static_cast<PriorityQueue*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    case VTREE_TYPE: VPRINT_PAGE(static_cast<VersionedTree*>(entry->dataPtr), page.offset, page.limit, out); break;
+                    default: throw CommandError(ERR_WRONG_TYPE, "PRINT не поддерживается для этого типа.");
+                }
+            });
+            return false;
+        }
+
+        if (command == "ISMEMBER") {
+            if (!nextArg(&args, arg1)) throw CommandError(ERR_SYNTAX, "Отсутствует значение для ISMEMBER.");
+            bool isMember = false;
+            switch (entry->type) {
+                case ARRAY_TYPE: isMember = MIS_MEMBER(static_cast<DynamicArray*>(entry->dataPtr), arg1); break;
+                case FLIST_TYPE: isMember = FIS_MEMBER(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1); break;
+                case LLIST_TYPE: isMember = LIS_MEMBER(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1); break;
+                case TREE_TYPE: isMember = TIS_MEMBER(static_cast<AVLTree*>(entry->dataPtr), arg1); break;
+                case BTREE_TYPE: isMember = BIS_MEMBER(static_cast<BPlusTree*>(entry->dataPtr), arg1); break;
+                case HSET_TYPE: isMember = HIS_MEMBER(static_cast<HashSet*>(entry->dataPtr), arg1); break;
+                case VTREE_TYPE: isMember = VIS_MEMBER(static_cast<VersionedTree*>(entry->dataPtr), arg1); break;
+                default: throw CommandError(ERR_WRONG_TYPE, "ISMEMBER не поддерживается для этого типа.");
+            }
+            replyBool(out, isMember);
+            return false;
+        }
+
+        if (command == "COUNT" || command == "FIND_ALL") {
+            if (!nextArg(&args, arg1)) throw CommandError(ERR_SYNTAX, "Отсутствует значение для " + command + ".");
+            std::vector<int64_t> positions;
+            int64_t count = 0;
+            bool findAll = command == "FIND_ALL";
+            switch (entry->type) {
+                case ARRAY_TYPE: { DynamicArray* array = static_cast<DynamicArray*>(entry->dataPtr); if (findAll) positions = MFIND_ALL(array, arg1); else count = MCOUNT(array, arg1); break; }
+                case FLIST_TYPE: { SinglyLinkedList* list = static_cast<SinglyLinkedList*>(entry->dataPtr); if (findAll) positions = FFIND_ALL(list, arg1); else count = FCOUNT(list, arg1); break; }
+                case LLIST_TYPE: { DoublyLinkedList* list = static_cast<DoublyLinkedList*>(entry->dataPtr); if (findAll) positions = LFIND_ALL(list, arg1); else count = LCOUNT(list, arg1); break; }
+                default: throw CommandError(ERR_WRONG_TYPE, command + " не поддерживается для этого типа.");
+            }
+            if (findAll) replyPositions(out, positions);
+            else replyInteger(out, count);
+            return false;
+        }
+
+        bool modified = false;
+
+        // Команды для конкретных типов
+        switch(entry->type) {
+            case ARRAY_TYPE:
+                if (command == "MPUSH_BACK") { DynamicArray* array = static_cast<DynamicArray*>(entry->dataPtr); if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); MGROW(array, array->size + static_cast<int64_t>(remainingArgs(&args))); while (takeArg(&args, arg1)) MPUSH_BACK(array, std::move(arg1)); modified = true; }
+                else if (command == "MINSERT_AT") { if (nextArg(&args, arg1) && takeArg(&args, arg2)) { MINSERT_AT(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1), std::move(arg2)); modified = true; } else throw CommandError(ERR_SYNTAX, "Нет индекса/значения."); }
+                else if (command == "MSET_AT") { if (nextArg(&args, arg1) && takeArg(&args, arg2)) { MSET_AT(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1), std::move(arg2)); modified = true; } else throw CommandError(ERR_SYNTAX, "Нет индекса/значения."); }
+                else if (command == "MDEL_AT") { if (nextArg(&args, arg1)) { replyValue(out, MDEL_AT(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1))); modified = true; } else throw CommandError(ERR_SYNTAX, "Нет индекса."); }
+                else if (command == "MGET") { if (nextArg(&args, arg1)) { replyValue(out, MGET(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1))); } else throw CommandError(ERR_SYNTAX, "Нет индекса."); }
+                else if (command == "MGET_RANGE") { if (nextArg(&args, arg1) && nextArg(&args, arg2)) { MPRINT_RANGE(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1), std::stoll(arg2), out); } else throw CommandError(ERR_SYNTAX, "Нет диапазона."); }
+                else if (command == "MLENGTH") { replyInteger(out, MLENGTH(static_cast<DynamicArray*>(entry->dataPtr))); }
+                else if (command == "MSORT") { MSORT(static_cast<DynamicArray*>(entry->dataPtr)); modified = true; }
+                else if (command == "MLOWER_BOUND") { if (nextArg(&args, arg1)) { replyInteger(out, MLOWER_BOUND(static_cast<DynamicArray*>(entry->dataPtr), arg1)); } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "MRESERVE") { if (nextArg(&args, arg1)) { MRESERVE(static_cast<DynamicArray*>(entry->dataPtr), std::stoll(arg1)); replyOK(out); } else throw CommandError(ERR_SYNTAX, "Нет ёмкости."); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для ARRAY.");
+                break;
+
+            case FLIST_TYPE: case LLIST_TYPE: {
+                char typeChar = (entry->type == FLIST_TYPE) ? 'F' : 'L';
+                if (command.length() < 2 || command[0] != typeChar) throw CommandError(ERR_WRONG_TYPE, "Неверный префикс команды для типа списка.");
+                std::string op = command.substr(1);
+                if (op == "PUSH_HEAD" || op == "PUSH_TAIL") { if (!takeArg(&args, arg1)) throw CommandError(ERR_SYNTAX, "Нет значения."); if (typeChar == 'F') { if (op == "PUSH_HEAD") FPUSH_HEAD(static_cast<SinglyLinkedList*>(entry->dataPtr), std::move(arg1)); else FPUSH_TAIL(static_cast<SinglyLinkedList*>(entry->dataPtr), std::move(arg1)); } else { if (op == "PUSH_HEAD") LPUSH_HEAD(static_cast<DoublyLinkedList*>(entry->dataPtr), std::move(arg1)); else LPUSH_TAIL(static_cast<DoublyLinkedList*>(entry->dataPtr), std::move(arg1)); } modified = true; }
+                else if (op == "INS_BEFORE" || op == "INS_AFTER") { if (!(nextArg(&args, arg1) && takeArg(&args, arg2))) throw CommandError(ERR_SYNTAX, "Нет аргументов."); bool res = false; if (typeChar == 'F') res = (op == "INS_BEFORE") ? FINS_BEFORE_VALUE(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1, std::move(arg2)) : FINS_AFTER_VALUE(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1, std::move(arg2)); else res = (op == "INS_BEFORE") ? LINS_BEFORE_VALUE(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1, std::move(arg2)) : LINS_AFTER_VALUE(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1, std::move(arg2)); if (res) replyOK(out); else replyNotFound(out); modified = res; }
+                else if (op == "DEL_HEAD" || op == "DEL_TAIL") { if (typeChar == 'F') replyValue(out, (op == "DEL_HEAD") ? FDEL_HEAD(static_cast<SinglyLinkedList*>(entry->dataPtr)) : FDEL_TAIL(static_cast<SinglyLinkedList*>(entry->dataPtr))); else replyValue(out, (op == "DEL_HEAD") ? LDEL_HEAD(static_cast<DoublyLinkedList*>(entry->dataPtr)) : LDEL_TAIL(static_cast<DoublyLinkedList*>(entry->dataPtr))); modified = true; }
+                else if (op == "DEL_BY_VALUE" || op == "DEL_BEFORE" || op == "DEL_AFTER") { if (!nextArg(&args, arg1)) throw CommandError(ERR_SYNTAX, "Нет значения."); bool res = false; if (typeChar == 'F') { if (op == "DEL_BY_VALUE") res = FDEL_BY_VALUE(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1); else if (op == "DEL_BEFORE") res = FDEL_BEFORE_VALUE(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1); else res = FDEL_AFTER_VALUE(static_cast<SinglyLinkedList*>(entry->dataPtr), arg1); } else { if (op == "DEL_BY_VALUE") res = LDEL_BY_VALUE(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1); else if (op == "DEL_BEFORE") res = LDEL_BEFORE_VALUE(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1); else res = LDEL_AFTER_VALUE(static_cast<DoublyLinkedList*>(entry->dataPtr), arg1); } if (res) replyOK(out); else replyNotFound(out); modified = res; }
+                else if (op == "GET_HEAD" || op == "GET_TAIL") { if (typeChar == 'F') replyValue(out, (op == "GET_HEAD") ? FGET_HEAD(static_cast<SinglyLinkedList*>(entry->dataPtr)) : FGET_TAIL(static_cast<SinglyLinkedList*>(entry->dataPtr))); else replyValue(out, (op == "GET_HEAD") ? LGET_HEAD(static_cast<DoublyLinkedList*>(entry->dataPtr)) : LGET_TAIL(static_cast<DoublyLinkedList*>(entry->dataPtr))); }
+                else if (op == "GET_AT") { if (!nextArg(&args, arg1)) throw CommandError(ERR_SYNTAX, "Нет индекса."); if (typeChar == 'F') replyValue(out, FGET_AT(static_cast<SinglyLinkedList*>(entry->dataPtr), std::stoll(arg1))); else replyValue(out, LGET_AT(static_cast<DoublyLinkedList*>(entry->dataPtr), std::stoll(arg1))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для списка.");
+                break;
+            }
+            case STACK_TYPE:
+                if (command == "SPUSH") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) SPUSH(static_cast<Stack*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "SPOP") { Stack* stack = static_cast<Stack*>(entry->dataPtr); if (nextArg(&args, arg1)) { int64_t count = std::min(parseCount(arg1), SLENGTH(stack)); replyArrayBegin(out, count); for (int64_t i = 0; i < count; ++i) replyArrayItem(out, SPOP(stack)); replyArrayEnd(out); modified = count > 0; } else { replyValue(out, SPOP(stack)); modified = true; } }
+                else if (command == "SPEAK") { replyValue(out, SPEEK(static_cast<Stack*>(entry->dataPtr))); }
+                else if (command == "SLENGTH") { replyInteger(out, SLENGTH(static_cast<Stack*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для STACK.");
+                break;
+            case QUEUE_TYPE:
+                if (command == "QPUSH") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) QPUSH(static_cast<Queue*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "QPOP") { Queue* queue = static_cast<Queue*>(entry->dataPtr); if (nextArg(&args, arg1)) { int64_t count = std::min(parseCount(arg1), queue->count); replyArrayBegin(out, count); for (int64_t i = 0; i < count; ++i) replyArrayItem(out, QPOP(queue)); replyArrayEnd(out); modified = count > 0; } else { replyValue(out, QPOP(queue)); modified = true; } }
+                else if (command == "QPEEK") { replyValue(out, QPEEK(static_cast<Queue*>(entry->dataPtr))); }
+                else if (command == "QLENGTH") { replyInteger(out, QLENGTH(static_cast<Queue*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для QUEUE.");
+                break;
+            case TREE_TYPE:
+                if (command == "TINSERT") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) TINSERT(static_cast<AVLTree*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "TDEL") { if (nextArg(&args, arg1)) { bool res = TDEL(static_cast<AVLTree*>(entry->dataPtr), arg1); if (res) replyOK(out); else replyNotFound(out); modified = res; } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "TGET") { if (nextArg(&args, arg1)) { bool found = TIS_MEMBER(static_cast<AVLTree*>(entry->dataPtr), arg1); if (found) replyValue(out, arg1); else replyNotFound(out); } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для TREE.");
+                break;
+            case BTREE_TYPE:
+                if (command == "BINSERT") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) BINSERT(static_cast<BPlusTree*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "BDEL") { if (nextArg(&args, arg1)) { bool res = BDEL(static_cast<BPlusTree*>(entry->dataPtr), arg1); if (res) replyOK(out); else replyNotFound(out); modified = res; } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "BGET") { if (nextArg(&args, arg1)) { bool found = BIS_MEMBER(static_cast<BPlusTree*>(entry->dataPtr), arg1); if (found) replyValue(out, arg1); else replyNotFound(out); } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "BRANGE") { if (nextArg(&args, arg1) && nextArg(&args, arg2)) { BRANGE(static_cast<BPlusTree*>(entry->dataPtr), arg1, arg2, out); } else throw CommandError(ERR_SYNTAX, "Нет диапазона."); }
+                else if (command == "BLENGTH") { replyInteger(out, BLENGTH(static_cast<BPlusTree*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для BTREE.");
+                break;
+            case HSET_TYPE:
+                if (command == "HADD") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) HADD(static_cast<HashSet*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "HDEL") { if (nextArg(&args, arg1)) { bool res = HDEL(static_cast<HashSet*>(entry->dataPtr), arg1); if (res) replyOK(out); else replyNotFound(out); modified = res; } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "HIS_MEMBER") { if (nextArg(&args, arg1)) replyBool(out, HIS_MEMBER(static_cast<HashSet*>(entry->dataPtr), arg1)); else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "HLENGTH") { replyInteger(out, HLENGTH(static_cast<HashSet*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для HSET.");
+                break;
+            case PQUEUE_TYPE:
+                if (command == "PPUSH") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) PPUSH(static_cast<PriorityQueue*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "PPOP") { PriorityQueue* queue = static_cast<PriorityQueue*>(entry->dataPtr); if (nextArg(&args, arg1)) { int64_t count = std::min(parseCount(arg1), PLENGTH(queue)); replyArrayBegin(out, count); for (int64_t i = 0; i < count; ++i) replyArrayItem(out, PPOP(queue)); replyArrayEnd(out); modified = count > 0; } else { replyValue(out, PPOP(queue)); modified = true; } }
+                else if (command == "PPEEK") { replyValue(out, PPEEK(static_cast<PriorityQueue*>(entry->dataPtr))); }
+                else if (command == "PTOPK") { if (nextArg(&args, arg1)) PTOPK(static_cast<PriorityQueue*>(entry->dataPtr), parseCount(arg1), out); else throw CommandError(ERR_SYNTAX, "Нет количества."); }
+                else if (command == "PLENGTH") { replyInteger(out, PLENGTH(static_cast<PriorityQueue*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для PQUEUE.");
+                break;
+            case VTREE_TYPE:
+                if (command == "VINSERT") { if (remainingArgs(&args) == 0) throw CommandError(ERR_SYNTAX, "Нет значения."); while (takeArg(&args, arg1)) VINSERT(static_cast<VersionedTree*>(entry->dataPtr), std::move(arg1)); modified = true; }
+                else if (command == "VDEL") { if (nextArg(&args, arg1)) { bool res = VDEL(static_cast<VersionedTree*>(entry->dataPtr), arg1); if (res) replyOK(out); else replyNotFound(out); modified = res; } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "VGET") { if (nextArg(&args, arg1)) { bool found = VIS_MEMBER(static_cast<VersionedTree*>(entry->dataPtr), arg1); if (found) replyValue(out, arg1); else replyNotFound(out); } else throw CommandError(ERR_SYNTAX, "Нет значения."); }
+                else if (command == "VRANGE") { if (nextArg(&args, arg1) && nextArg(&args, arg2)) { VRANGE(static_cast<VersionedTree*>(entry->dataPtr), arg1, arg2, out); } else throw CommandError(ERR_SYNTAX, "Нет диапазона."); }
+                else if (command == "VLENGTH") { replyInteger(out, VLENGTH(static_cast<VersionedTree*>(entry->dataPtr))); }
+                else throw CommandError(ERR_UNKNOWN_COMMAND, "Неизвестная команда для VTREE.");
+                break;
+            default:
+                throw CommandError(ERR_WRONG_TYPE, "Неподдерживаемый тип структуры.");
+        }
+
+        if (modified) {
+             if (command.find("DEL") == std::string::npos && command.find("POP") == std::string::npos && command.find("INS_") == std::string::npos) {
+                replyOK(out);
+             }
+        }
+        return modified;
+
+    } catch (const CommandError& e) {
+        replyError(out, e.code, e.what());
+    } catch (const std::out_of_range& e) {
+        replyError(out, ERR_OUT_OF_RANGE, e.what());
+    } catch (const std::invalid_argument& e) {
+        replyError(out, ERR_SYNTAX, e.what());
+    } catch (const std::underflow_error& e) {
+        replyError(out, ERR_EMPTY, e.what());
+    } catch (const std::exception& e) {
+        replyError(out, ERR_FAILED, e.what());
+    }
+    return false;
+}
+
+bool executeCommand(struct DataStore* store, const std::vector<std::string>& tokens, struct OutputBuffer* out) {
+    return executeArgs(store, {&tokens, 0, nullptr}, out);
+}
+
+bool executeCommand(struct DataStore* store, std::vector<std::string>&& tokens, struct OutputBuffer* out) {
+    return executeArgs(store, {&tokens, 0, &tokens}, out);
+}
+
+bool processCommand(struct DataStore* store, const std::string& line, struct OutputBuffer* out) {
+    std::vector<std::string> tokens;
+    splitCommandLine(line, &tokens);
+    return executeCommand(store, std::move(tokens), out);
+}
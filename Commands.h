@@ -0,0 +1,36 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "Store.h"
+#include <vector>
+
+#define SCAN_DEFAULT_COUNT 10
+
+struct PageRequest {
+    bool isScan;
+    int64_t offset;
+    int64_t limit;
+};
+
+// owned - те же токены, если вызывающий их отдал: тогда takeArg забирает значения перемещением.
+struct CommandArgs {
+    const std::vector<std::string>* tokens;
+    size_t position;
+    std::vector<std::string>* owned;
+};
+
+bool nextArg(struct CommandArgs* args, std::string& value);
+bool takeArg(struct CommandArgs* args, std::string& value);
+size_t remainingArgs(const struct CommandArgs* args);
+int64_t parseCount(const std::string& value);
+void splitCommandLine(const std::string& line, std::vector<std::string>* tokens);
+void printHelp(struct OutputBuffer* out);
+bool isWriteCommand(const std::string& command);
+// Команды над несколькими деревьями (TUNION, TINTERSECT, TDIFF): с --shards не привязаны к одному шарду.
+bool isTreeSetCommand(const std::string& command);
+bool executeCommand(struct DataStore* store, const std::vector<std::string>& tokens, struct OutputBuffer* out);
+// Токены после вызова не нужны вызывающему: сохраняемые значения переезжают в структуры без копий.
+bool executeCommand(struct DataStore* store, std::vector<std::string>&& tokens, struct OutputBuffer* out);
+bool processCommand(struct DataStore* store, const std::string& line, struct OutputBuffer* out);
+
+#endif
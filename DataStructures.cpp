@@ -1,103 +1,370 @@
 #include "DataStructures.h"
+#include "Scan.h"
 #include <stdexcept>
+#include <vector>
+#include <functional>
+#include <new>
+#include <limits>
+#include <sys/mman.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-void resizeArray(struct DynamicArray* array, int newCapacity) {
+thread_local struct OpCounters* activeCounters = nullptr;
+
+// Хранилище массива - сырая память: строки живут только в [0, size), запас не конструируется.
+static std::string* allocateElements(int64_t capacity) {
+    return static_cast<std::string*>(::operator new(sizeof(std::string) * static_cast<size_t>(capacity)));
+}
+
+static void destroyElements(std::string* elements, int64_t from, int64_t to) {
+    for (int64_t i = from; i < to; ++i) elements[i].~basic_string();
+}
+
+static size_t elementBytes(int64_t capacity) {
+    return sizeof(std::string) * static_cast<size_t>(capacity);
+}
+
+static bool mappedCapacity(int64_t capacity) {
+    return ARRAY_MMAP_THRESHOLD > 0 && elementBytes(capacity) >= static_cast<size_t>(ARRAY_MMAP_THRESHOLD);
+}
+
+static size_t hugePageRound(size_t bytes) {
+    return (bytes + ARRAY_HUGE_PAGE - 1) / ARRAY_HUGE_PAGE * ARRAY_HUGE_PAGE;
+}
+
+// Адресное пространство берётся с запасом ARRAY_MMAP_RESERVE: с MAP_NORESERVE под него не
+// резервируется память, физические страницы появляются только при записи.
+static std::string* mapElements(int64_t capacity, size_t* mappedBytes) {
+    size_t bytes = hugePageRound(elementBytes(capacity) * ARRAY_MMAP_RESERVE);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) throw std::bad_alloc();
+    madvise(memory, bytes, MADV_HUGEPAGE);
+    *mappedBytes = bytes;
+    return static_cast<std::string*>(memory);
+}
+
+static void freeElements(struct DynamicArray* array) {
+    if (array->mappedBytes > 0) munmap(array->elements, array->mappedBytes);
+    else ::operator delete(array->elements);
+    array->mappedBytes = 0;
+}
+
+// Отображённый массив меняет ёмкость на месте: в пределах отображения - без системных вызовов
+// (при сжатии хвост отдаётся через MADV_DONTNEED), дальше - mremap без MREMAP_MAYMOVE.
+// Переезд по другому адресу недопустим: строки libstdc++ нельзя переносить побайтно.
+static bool resizeMapped(struct DynamicArray* array, int64_t newCapacity) {
+    if (array->mappedBytes == 0 || !mappedCapacity(newCapacity)) return false;
+    size_t needed = elementBytes(newCapacity);
+    if (needed > array->mappedBytes) {
+        size_t bytes = hugePageRound(needed * ARRAY_MMAP_RESERVE);
+        if (mremap(array->elements, array->mappedBytes, bytes, 0) == MAP_FAILED) return false;
+        madvise(reinterpret_cast<char*>(array->elements) + array->mappedBytes, bytes - array->mappedBytes, MADV_HUGEPAGE);
+        array->mappedBytes = bytes;
+    } else if (newCapacity < array->capacity) {
+        size_t keep = hugePageRound(needed);
+        if (keep < array->mappedBytes) madvise(reinterpret_cast<char*>(array->elements) + keep, array->mappedBytes - keep, MADV_DONTNEED);
+    }
+    array->capacity = newCapacity;
+    return true;
+}
+
+// Перенос при смене ёмкости - перемещением: символы строк не копируются, переезжают только
+// сами объекты std::string. memcpy здесь нельзя - в libstdc++ короткая строка указывает сама в себя.
+void resizeArray(struct DynamicArray* array, int64_t newCapacity) {
     if (newCapacity < array->size) newCapacity = array->size;
-    if (newCapacity < 4) newCapacity = 4;
-    std::string* newElements = new std::string[newCapacity];
-    for (int i = 0; i < array->size; ++i) {
-        newElements[i] = array->elements[i];
+    if (newCapacity < ARRAY_MIN_CAPACITY) newCapacity = ARRAY_MIN_CAPACITY;
+    if (newCapacity == array->capacity) return;
+    if (static_cast<size_t>(newCapacity) > std::numeric_limits<size_t>::max() / sizeof(std::string) / ARRAY_MMAP_RESERVE) throw std::bad_alloc();
+    PROFILE_COUNT(resizes, 1);
+    if (resizeMapped(array, newCapacity)) return;
+    size_t mappedBytes = 0;
+    std::string* newElements = mappedCapacity(newCapacity) ? mapElements(newCapacity, &mappedBytes) : allocateElements(newCapacity);
+    for (int64_t i = 0; i < array->size; ++i) {
+        new (&newElements[i]) std::string(std::move(array->elements[i]));
+        array->elements[i].~basic_string();
     }
-    delete[] array->elements;
+    PROFILE_COUNT(bytesCopied, elementBytes(array->size));
+    freeElements(array);
     array->elements = newElements;
     array->capacity = newCapacity;
+    array->mappedBytes = mappedBytes;
+}
+
+// Гистерезис: рост при заполнении вдвое, сжатие вдвое только при заполнении не больше четверти,
+// поэтому чередование вставок и удалений на границе не гоняет память туда-обратно.
+// Ёмкость, заказанная через MRESERVE, не отдаётся.
+static void shrinkArray(struct DynamicArray* array) {
+    int64_t floor = std::max<int64_t>(array->reserved, ARRAY_MIN_CAPACITY);
+    if (array->capacity <= floor || array->size > array->capacity / 4) return;
+    resizeArray(array, std::max(array->capacity / 2, floor));
+}
+
+int64_t pageLength(int64_t total, int64_t offset, int64_t limit) {
+    if (offset < 0 || limit < 0) throw std::out_of_range("Invalid page.");
+    if (offset >= total) return 0;
+    return std::min(limit, total - offset);
 }
 
 void MCREATE(struct DynamicArray* array) {
     array->size = 0;
-    array->capacity = 4;
-    array->elements = new std::string[array->capacity];
+    array->capacity = ARRAY_MIN_CAPACITY;
+    array->reserved = 0;
+    array->mappedBytes = 0;
+    array->sorted = false;
+    array->elements = allocateElements(array->capacity);
 }
 
 void MDESTROY(struct DynamicArray* array) {
     if (array->elements != nullptr) {
-        delete[] array->elements;
+        destroyElements(array->elements, 0, array->size);
+        freeElements(array);
         array->elements = nullptr;
     }
     array->size = 0;
     array->capacity = 0;
+    array->reserved = 0;
+    array->sorted = false;
 }
 
-void MPUSH_BACK(struct DynamicArray* array, const std::string& value) {
+// Рост под пачку вставок: не меньше удвоения, чтобы серия мелких пачек оставалась амортизированно O(1).
+void MGROW(struct DynamicArray* array, int64_t capacity) {
+    if (capacity > array->capacity) resizeArray(array, std::max(capacity, array->capacity * 2));
+}
+
+void MRESERVE(struct DynamicArray* array, int64_t capacity) {
+    if (capacity < 0) throw std::out_of_range("Invalid capacity.");
+    array->reserved = capacity;
+    if (capacity > array->capacity) resizeArray(array, capacity);
+}
+
+// Сохранит ли value на месте index порядок отсортированного массива, если соседи - [index - 1] и [next].
+static bool keepsOrder(const struct DynamicArray* array, int64_t index, int64_t next, const std::string& value) {
+    return (index == 0 || array->elements[index - 1] <= value) && (next >= array->size || value <= array->elements[next]);
+}
+
+void MPUSH_BACK(struct DynamicArray* array, std::string&& value) {
+    if (array->sorted && !keepsOrder(array, array->size, array->size, value)) array->sorted = false;
     if (array->size == array->capacity) {
         resizeArray(array, array->capacity * 2);
     }
-    array->elements[array->size++] = value;
+    new (&array->elements[array->size]) std::string(std::move(value));
+    array->size++;
 }
 
-void MINSERT_AT(struct DynamicArray* array, int index, const std::string& value) {
+void MPUSH_BACK(struct DynamicArray* array, const std::string& value) {
+    MPUSH_BACK(array, std::string(value));
+}
+
+void MINSERT_AT(struct DynamicArray* array, int64_t index, std::string&& value) {
     if (index < 0 || index > array->size) throw std::out_of_range("Invalid index for insert.");
+    if (array->sorted && !keepsOrder(array, index, index, value)) array->sorted = false;
     if (array->size == array->capacity) {
         resizeArray(array, array->capacity * 2);
     }
-    for (int i = array->size; i > index; --i) {
-        array->elements[i] = array->elements[i - 1];
+    if (index == array->size) {
+        new (&array->elements[array->size]) std::string(std::move(value));
+    } else {
+        new (&array->elements[array->size]) std::string(std::move(array->elements[array->size - 1]));
+        std::move_backward(array->elements + index, array->elements + array->size - 1, array->elements + array->size);
+        PROFILE_COUNT(bytesCopied, sizeof(std::string) * static_cast<size_t>(array->size - index));
+        array->elements[index] = std::move(value);
     }
-    array->elements[index] = value;
     array->size++;
 }
 
-void MSET_AT(struct DynamicArray* array, int index, const std::string& value) {
+void MINSERT_AT(struct DynamicArray* array, int64_t index, const std::string& value) {
+    MINSERT_AT(array, index, std::string(value));
+}
+
+void MSET_AT(struct DynamicArray* array, int64_t index, std::string&& value) {
     if (index < 0 || index >= array->size) throw std::out_of_range("Invalid index for set.");
-    array->elements[index] = value;
+    if (array->sorted && !keepsOrder(array, index, index + 1, value)) array->sorted = false;
+    array->elements[index] = std::move(value);
+}
+
+void MSET_AT(struct DynamicArray* array, int64_t index, const std::string& value) {
+    MSET_AT(array, index, std::string(value));
 }
 
-std::string MDEL_AT(struct DynamicArray* array, int index) {
+std::string MDEL_AT(struct DynamicArray* array, int64_t index) {
     if (index < 0 || index >= array->size) throw std::out_of_range("Invalid index.");
-    std::string removedValue = array->elements[index];
-    for (int i = index; i < array->size - 1; ++i) {
-        array->elements[i] = array->elements[i + 1];
-    }
+    std::string removedValue = std::move(array->elements[index]);
+    std::move(array->elements + index + 1, array->elements + array->size, array->elements + index);
+    PROFILE_COUNT(bytesCopied, sizeof(std::string) * static_cast<size_t>(array->size - index - 1));
     array->size--;
-    if (array->size > 0 && array->size <= array->capacity / 4) {
-        resizeArray(array, array->capacity / 2);
-    }
+    array->elements[array->size].~basic_string();
+    shrinkArray(array);
     return removedValue;
 }
 
-std::string MGET(const struct DynamicArray* array, int index) {
+std::string MGET(const struct DynamicArray* array, int64_t index) {
     if (index < 0 || index >= array->size) throw std::out_of_range("Invalid index.");
     return array->elements[index];
 }
 
-bool MIS_MEMBER(const struct DynamicArray* array, const std::string& value) {
-    for (int i = 0; i < array->size; ++i) {
-        if (array->elements[i] == value) return true;
+static bool countedLess(const std::string& a, const std::string& b) {
+    PROFILE_COUNT(comparisons, 1);
+    return a < b;
+}
+
+void MSORT(struct DynamicArray* array) {
+    parallelSort(array->elements, array->size);
+    array->sorted = true;
+}
+
+int64_t MLOWER_BOUND(const struct DynamicArray* array, const std::string& value) {
+    if (!array->sorted) throw std::logic_error("Array is not sorted.");
+    return std::lower_bound(array->elements, array->elements + array->size, value, countedLess) - array->elements;
+}
+
+// У отсортированного массива совпадения образуют отрезок, его границы находит двоичный поиск.
+static struct ScanResult scanArray(const struct DynamicArray* array, const std::string& value, int64_t limit, std::vector<int64_t>* positions) {
+    const std::string* elements = array->elements;
+    if (array->sorted) {
+        int64_t first = MLOWER_BOUND(array, value);
+        int64_t last = std::upper_bound(elements + first, elements + array->size, value, countedLess) - elements;
+        struct ScanResult result = {std::min(last - first, limit), 0};
+        if (positions) {
+            for (int64_t i = first; i < last; ++i) positions->push_back(i);
+        }
+        return result;
     }
-    return false;
+    struct ScanResult result = scanIndexed(array->size, value, limit, positions, [elements](int64_t i) { return std::string_view(elements[i]); });
+    PROFILE_COUNT(comparisons, result.visited);
+    return result;
+}
+
+bool MIS_MEMBER(const struct DynamicArray* array, const std::string& value) {
+    return scanArray(array, value, 1, nullptr).matches > 0;
+}
+
+int64_t MCOUNT(const struct DynamicArray* array, const std::string& value) {
+    return scanArray(array, value, SCAN_ALL, nullptr).matches;
 }
 
-int MLENGTH(const struct DynamicArray* array) {
+std::vector<int64_t> MFIND_ALL(const struct DynamicArray* array, const std::string& value) {
+    std::vector<int64_t> positions;
+    scanArray(array, value, SCAN_ALL, &positions);
+    return positions;
+}
+
+int64_t MLENGTH(const struct DynamicArray* array) {
     return array->size;
 }
 
-void MPRINT(const struct DynamicArray* array) {
-    for (int i = 0; i < array->size; ++i) {
-        std::cout << array->elements[i] << (i < array->size - 1 ? " " : "");
+void MPRINT(const struct DynamicArray* array, struct OutputBuffer* out) {
+    MPRINT_PAGE(array, 0, array->size, out);
+}
+
+void MPRINT_PAGE(const struct DynamicArray* array, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(array->size, offset, limit);
+    replyArrayBegin(out, count);
+    for (int64_t i = offset; i < offset + count; ++i) {
+        replyArrayItem(out, array->elements[i]);
     }
-    std::cout << std::endl;
+    replyArrayEnd(out);
 }
 
-struct FNode* createFNode(const std::string& value) {
-    struct FNode* node = new struct FNode;
-    node->data = value;
-    node->next = nullptr;
-    return node;
+void MPRINT_RANGE(const struct DynamicArray* array, int64_t from, int64_t to, struct OutputBuffer* out) {
+    if (from < 0 || to < from) throw std::out_of_range("Invalid range.");
+    if (to >= array->size) to = array->size - 1;
+    replyArrayBegin(out, from <= to ? to - from + 1 : 0);
+    for (int64_t i = from; i <= to; ++i) {
+        replyArrayItem(out, array->elements[i]);
+    }
+    replyArrayEnd(out);
+}
+
+static int nodeSize(const struct FNode*) {
+    return 1;
+}
+
+static int nodeSize(const struct LNode* node) {
+    return node->count;
+}
+
+static const std::string& nodeValue(const struct FNode* node, int) {
+    return node->data;
+}
+
+static const std::string& nodeValue(const struct LNode* node, int slot) {
+    return node->values[slot];
+}
+
+// Поиск по списку. Короткие списки проходятся подряд; у длинных куски между опорными узлами
+// list->chunks (примерно по SCAN_CHUNK значений) раздаются потокам, а номера совпадений
+// восстанавливаются по длинам кусков.
+template <typename List>
+static struct ScanResult scanList(List* list, const std::string& value, int64_t limit, std::vector<int64_t>* positions) {
+    struct ScanResult result = {0, 0};
+    int64_t nodes = 0;
+    if (list->length < SCAN_PARALLEL_THRESHOLD) {
+        for (auto* current = list->head; current != nullptr && result.matches < limit; current = current->next) {
+            ++nodes;
+            for (int slot = 0; slot < nodeSize(current) && result.matches < limit; ++slot) {
+                int64_t index = result.visited++;
+                if (nodeValue(current, slot) != value) continue;
+                ++result.matches;
+                if (positions) positions->push_back(index);
+            }
+        }
+    } else {
+        if (list->chunks.empty() || list->length >= 2 * list->chunkedLength) {
+            list->chunks.clear();
+            int64_t index = 0, nextAnchor = 0;
+            for (auto* current = list->head; current != nullptr; current = current->next) {
+                if (index >= nextAnchor) {
+                    list->chunks.push_back(current);
+                    nextAnchor = index + SCAN_CHUNK;
+                }
+                index += nodeSize(current);
+            }
+            list->chunkedLength = list->length;
+        }
+
+        int64_t chunks = static_cast<int64_t>(list->chunks.size());
+        std::vector<int64_t> lengths(chunks, 0);
+        std::vector<std::vector<int64_t>> hits(positions ? chunks : 0);
+        std::atomic<int64_t> matches(0), walked(0);
+        parallelScan(chunks, [&](int64_t chunk) {
+            auto* current = chunk == 0 ? list->head : list->chunks[chunk];
+            auto* end = chunk + 1 < chunks ? list->chunks[chunk + 1] : nullptr;
+            int64_t offset = 0, found = 0, chunkNodes = 0;
+            for (; current != end; current = current->next, ++chunkNodes) {
+                for (int slot = 0; slot < nodeSize(current); ++slot, ++offset) {
+                    if (nodeValue(current, slot) != value) continue;
+                    ++found;
+                    if (positions) hits[chunk].push_back(offset);
+                }
+            }
+            lengths[chunk] = offset;
+            walked.fetch_add(chunkNodes, std::memory_order_relaxed);
+            return matches.fetch_add(found, std::memory_order_relaxed) + found < limit;
+        });
+        for (int64_t chunk = 0; chunk < chunks; ++chunk) {
+            if (positions) {
+                for (int64_t offset : hits[chunk]) positions->push_back(result.visited + offset);
+            }
+            result.visited += lengths[chunk];
+        }
+        result.matches = std::min(matches.load(), limit);
+        nodes = walked.load();
+    }
+    PROFILE_COUNT(nodesVisited, nodes);
+    PROFILE_COUNT(comparisons, result.visited);
+    return result;
+}
+
+struct FNode* createFNode(std::string&& value) {
+    return new FNode{std::move(value), nullptr};
 }
 
 void FCREATE(struct SinglyLinkedList* list) {
     list->head = list->tail = nullptr;
     list->length = 0;
+    list->chunks.clear();
+    list->chunkedLength = 0;
 }
 
 void FDESTROY(struct SinglyLinkedList* list) {
@@ -110,8 +377,8 @@ void FDESTROY(struct SinglyLinkedList* list) {
     FCREATE(list);
 }
 
-void FPUSH_HEAD(struct SinglyLinkedList* list, const std::string& value) {
-    struct FNode* newNode = createFNode(value);
+void FPUSH_HEAD(struct SinglyLinkedList* list, std::string&& value) {
+    struct FNode* newNode = createFNode(std::move(value));
     newNode->next = list->head;
     list->head = newNode;
     if (list->tail == nullptr) {
@@ -120,8 +387,12 @@ void FPUSH_HEAD(struct SinglyLinkedList* list, const std::string& value) {
     list->length++;
 }
 
-void FPUSH_TAIL(struct SinglyLinkedList* list, const std::string& value) {
-    struct FNode* newNode = createFNode(value);
+void FPUSH_HEAD(struct SinglyLinkedList* list, const std::string& value) {
+    FPUSH_HEAD(list, std::string(value));
+}
+
+void FPUSH_TAIL(struct SinglyLinkedList* list, std::string&& value) {
+    struct FNode* newNode = createFNode(std::move(value));
     if (list->tail == nullptr) {
         list->head = list->tail = newNode;
     } else {
@@ -131,16 +402,22 @@ void FPUSH_TAIL(struct SinglyLinkedList* list, const std::string& value) {
     list->length++;
 }
 
-bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeValue, const std::string& newValue) {
+void FPUSH_TAIL(struct SinglyLinkedList* list, const std::string& value) {
+    FPUSH_TAIL(list, std::string(value));
+}
+
+bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeValue, std::string&& newValue) {
     struct FNode* current = list->head;
     struct FNode* prev = nullptr;
     while (current != nullptr && current->data != beforeValue) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
         prev = current;
         current = current->next;
     }
     if (current == nullptr) return false;
 
-    struct FNode* newNode = createFNode(newValue);
+    struct FNode* newNode = createFNode(std::move(newValue));
     if (prev == nullptr) {
         newNode->next = list->head;
         list->head = newNode;
@@ -152,14 +429,20 @@ bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeV
     return true;
 }
 
-bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterValue, const std::string& newValue) {
+bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeValue, const std::string& newValue) {
+    return FINS_BEFORE_VALUE(list, beforeValue, std::string(newValue));
+}
+
+bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterValue, std::string&& newValue) {
     struct FNode* current = list->head;
     while (current != nullptr && current->data != afterValue) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
         current = current->next;
     }
     if (current == nullptr) return false;
 
-    struct FNode* newNode = createFNode(newValue);
+    struct FNode* newNode = createFNode(std::move(newValue));
     newNode->next = current->next;
     current->next = newNode;
 
@@ -170,26 +453,32 @@ bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterVal
     return true;
 }
 
+bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterValue, const std::string& newValue) {
+    return FINS_AFTER_VALUE(list, afterValue, std::string(newValue));
+}
+
 std::string FDEL_HEAD(struct SinglyLinkedList* list) {
-    if (list->head == nullptr) throw std::runtime_error("Singly Linked List is empty.");
-    std::string data = list->head->data;
+    if (list->head == nullptr) throw std::underflow_error("Singly Linked List is empty.");
+    std::string data = std::move(list->head->data);
     struct FNode* temp = list->head;
     list->head = list->head->next;
     if (list->head == nullptr) list->tail = nullptr;
     delete temp;
     list->length--;
+    list->chunks.clear();
     return data;
 }
 
 std::string FDEL_TAIL(struct SinglyLinkedList* list) {
-    if (list->tail == nullptr) throw std::runtime_error("Singly Linked List is empty.");
-    std::string data = list->tail->data;
+    if (list->tail == nullptr) throw std::underflow_error("Singly Linked List is empty.");
+    std::string data = std::move(list->tail->data);
     if (list->head == list->tail) {
         delete list->head;
         list->head = list->tail = nullptr;
     } else {
         struct FNode* current = list->head;
         while (current->next != list->tail) {
+            PROFILE_COUNT(nodesVisited, 1);
             current = current->next;
         }
         delete list->tail;
@@ -197,6 +486,7 @@ std::string FDEL_TAIL(struct SinglyLinkedList* list) {
         current->next = nullptr;
     }
     list->length--;
+    list->chunks.clear();
     return data;
 }
 
@@ -204,6 +494,8 @@ bool FDEL_BY_VALUE(struct SinglyLinkedList* list, const std::string& value) {
     struct FNode* current = list->head;
     struct FNode* prev = nullptr;
     while (current != nullptr && current->data != value) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
         prev = current;
         current = current->next;
     }
@@ -217,6 +509,7 @@ bool FDEL_BY_VALUE(struct SinglyLinkedList* list, const std::string& value) {
     }
     delete current;
     list->length--;
+    list->chunks.clear();
     return true;
 }
 
@@ -233,6 +526,8 @@ bool FDEL_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& value)
     struct FNode* current = list->head;
 
     while (current->next != nullptr && current->next->next != nullptr && current->next->next->data != value) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
         current = current->next;
     }
 
@@ -242,6 +537,7 @@ bool FDEL_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& value)
         if (toDelete == list->tail) list->tail = current;
         delete toDelete;
         list->length--;
+        list->chunks.clear();
         return true;
     }
 
@@ -251,6 +547,8 @@ bool FDEL_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& value)
 bool FDEL_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& value) {
     struct FNode* current = list->head;
     while (current != nullptr && current->data != value) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
         current = current->next;
     }
 
@@ -267,49 +565,65 @@ bool FDEL_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& value) {
 
     delete toDelete;
     list->length--;
+    list->chunks.clear();
     return true;
 }
 
 std::string FGET_HEAD(const struct SinglyLinkedList* list) {
-    if (list->head == nullptr) throw std::runtime_error("Singly Linked List is empty.");
+    if (list->head == nullptr) throw std::underflow_error("Singly Linked List is empty.");
     return list->head->data;
 }
 
 std::string FGET_TAIL(const struct SinglyLinkedList* list) {
-    if (list->tail == nullptr) throw std::runtime_error("Singly Linked List is empty.");
+    if (list->tail == nullptr) throw std::underflow_error("Singly Linked List is empty.");
     return list->tail->data;
 }
 
-std::string FGET_AT(const struct SinglyLinkedList* list, int index) {
+std::string FGET_AT(const struct SinglyLinkedList* list, int64_t index) {
     if (index < 0 || index >= list->length) throw std::out_of_range("Invalid index.");
     struct FNode* current = list->head;
-    for(int i = 0; i < index; ++i) {
+    PROFILE_COUNT(nodesVisited, index);
+    for (int64_t i = 0; i < index; ++i) {
         current = current->next;
     }
     return current->data;
 }
 
-bool FIS_MEMBER(const struct SinglyLinkedList* list, const std::string& value) {
-    struct FNode* current = list->head;
-    while (current != nullptr) {
-        if (current->data == value) return true;
-        current = current->next;
-    }
-    return false;
+bool FIS_MEMBER(struct SinglyLinkedList* list, const std::string& value) {
+    return scanList(list, value, 1, nullptr).matches > 0;
+}
+
+int64_t FCOUNT(struct SinglyLinkedList* list, const std::string& value) {
+    return scanList(list, value, SCAN_ALL, nullptr).matches;
 }
 
-void FPRINT(const struct SinglyLinkedList* list) {
+std::vector<int64_t> FFIND_ALL(struct SinglyLinkedList* list, const std::string& value) {
+    std::vector<int64_t> positions;
+    scanList(list, value, SCAN_ALL, &positions);
+    return positions;
+}
+
+void FPRINT(const struct SinglyLinkedList* list, struct OutputBuffer* out) {
+    FPRINT_PAGE(list, 0, list->length, out);
+}
+
+void FPRINT_PAGE(const struct SinglyLinkedList* list, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(list->length, offset, limit);
+    replyArrayBegin(out, count);
     struct FNode* current = list->head;
-    while (current != nullptr) {
-        std::cout << current->data << (current->next != nullptr ? " " : "");
+    for (int64_t i = 0; i < offset; ++i) current = current->next;
+    for (int64_t i = 0; i < count; ++i) {
+        replyArrayItem(out, current->data);
         current = current->next;
     }
-    std::cout << std::endl;
+    replyArrayEnd(out);
 }
 
 void LCREATE(struct DoublyLinkedList* list) {
     list->head = list->tail = nullptr;
     list->length = 0;
+    list->chunks.clear();
+    list->chunkedLength = 0;
 }
 
 void LDESTROY(struct DoublyLinkedList* list) {
@@ -322,262 +636,281 @@ void LDESTROY(struct DoublyLinkedList* list) {
     LCREATE(list);
 }
 
-void LPUSH_HEAD(struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* newNode = new struct LNode;
-    newNode->data = value;
-    newNode->prev = nullptr;
-    newNode->next = list->head;
-    if (list->head == nullptr) {
-        list->tail = newNode;
-    } else {
-        list->head->prev = newNode;
+// Вставляет пустой узел после node (nullptr - в начало списка).
+static struct LNode* linkLNode(struct DoublyLinkedList* list, struct LNode* node) {
+    struct LNode* newNode = new LNode;
+    newNode->count = 0;
+    newNode->prev = node;
+    newNode->next = node ? node->next : list->head;
+    if (newNode->next) newNode->next->prev = newNode;
+    else list->tail = newNode;
+    if (node) node->next = newNode;
+    else list->head = newNode;
+    return newNode;
+}
+
+static void unlinkLNode(struct DoublyLinkedList* list, struct LNode* node) {
+    if (node->prev) node->prev->next = node->next;
+    else list->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else list->tail = node->prev;
+    delete node;
+    list->chunks.clear();
+}
+
+static void insertIntoLNode(struct DoublyLinkedList* list, struct LNode* node, int slot, std::string&& value) {
+    if (node->count == LNODE_CAPACITY) {
+        struct LNode* upper = linkLNode(list, node);
+        int half = LNODE_CAPACITY / 2;
+        std::move(node->values + half, node->values + LNODE_CAPACITY, upper->values);
+        upper->count = LNODE_CAPACITY - half;
+        node->count = half;
+        if (slot > half) {
+            node = upper;
+            slot -= half;
+        }
     }
-    list->head = newNode;
+    std::move_backward(node->values + slot, node->values + node->count, node->values + node->count + 1);
+    node->values[slot] = std::move(value);
+    node->count++;
     list->length++;
 }
 
-void LPUSH_TAIL(struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* newNode = new struct LNode;
-    newNode->data = value;
-    newNode->next = nullptr;
-    newNode->prev = list->tail;
-    if (list->tail == nullptr) {
-        list->head = newNode;
-    } else {
-        list->tail->next = newNode;
-    }
-    list->tail = newNode;
-    list->length++;
+static void mergeLNodes(struct DoublyLinkedList* list, struct LNode* left, struct LNode* right) {
+    std::move(right->values, right->values + right->count, left->values + left->count);
+    left->count += right->count;
+    unlinkLNode(list, right);
 }
 
-bool LINS_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& beforeValue, const std::string& newValue) {
-    struct LNode* current = list->head;
-    while (current != nullptr && current->data != beforeValue) {
-        current = current->next;
+static std::string eraseFromLNode(struct DoublyLinkedList* list, struct LNode* node, int slot) {
+    std::string value = std::move(node->values[slot]);
+    std::move(node->values + slot + 1, node->values + node->count, node->values + slot);
+    node->count--;
+    list->length--;
+    if (node->count == 0) {
+        unlinkLNode(list, node);
+    } else if (node->count < LNODE_CAPACITY / 2) {
+        if (node->next && node->count + node->next->count <= LNODE_CAPACITY) mergeLNodes(list, node, node->next);
+        else if (node->prev && node->prev->count + node->count <= LNODE_CAPACITY) mergeLNodes(list, node->prev, node);
     }
-    if (current == nullptr) return false;
-
-    struct LNode* newNode = new struct LNode;
-    newNode->data = newValue;
-    newNode->next = current;
-    newNode->prev = current->prev;
+    return value;
+}
+
+// Первое вхождение value: узел и ячейка в нём.
+static bool findLValue(const struct DoublyLinkedList* list, const std::string& value, struct LNode** node, int* slot) {
+    for (struct LNode* current = list->head; current != nullptr; current = current->next) {
+        PROFILE_COUNT(nodesVisited, 1);
+        for (int i = 0; i < current->count; ++i) {
+            PROFILE_COUNT(comparisons, 1);
+            if (current->values[i] != value) continue;
+            *node = current;
+            *slot = i;
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (current->prev == nullptr) {
-        list->head = newNode;
+// Узел и ячейка элемента с номером index; идёт с ближнего конца, пропуская узлы целиком.
+static struct LNode* locateLIndex(const struct DoublyLinkedList* list, int64_t index, int* slot) {
+    struct LNode* current;
+    if (index < list->length / 2) {
+        current = list->head;
+        while (index >= current->count) {
+            PROFILE_COUNT(nodesVisited, 1);
+            index -= current->count;
+            current = current->next;
+        }
     } else {
-        current->prev->next = newNode;
+        int64_t fromEnd = list->length - 1 - index;
+        current = list->tail;
+        while (fromEnd >= current->count) {
+            PROFILE_COUNT(nodesVisited, 1);
+            fromEnd -= current->count;
+            current = current->prev;
+        }
+        index = current->count - 1 - fromEnd;
     }
-    current->prev = newNode;
-    list->length++;
-    return true;
+    *slot = static_cast<int>(index);
+    return current;
 }
 
-bool LINS_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& afterValue, const std::string& newValue) {
-    struct LNode* current = list->head;
-    while (current != nullptr && current->data != afterValue) {
-        current = current->next;
-    }
-    if (current == nullptr) return false;
+void LPUSH_HEAD(struct DoublyLinkedList* list, std::string&& value) {
+    struct LNode* node = list->head;
+    if (node == nullptr || node->count == LNODE_CAPACITY) node = linkLNode(list, nullptr);
+    insertIntoLNode(list, node, 0, std::move(value));
+}
 
-    struct LNode* newNode = new struct LNode;
-    newNode->data = newValue;
-    newNode->prev = current;
-    newNode->next = current->next;
+void LPUSH_HEAD(struct DoublyLinkedList* list, const std::string& value) {
+    LPUSH_HEAD(list, std::string(value));
+}
 
-    if (current->next == nullptr) {
-        list->tail = newNode;
-    } else {
-        current->next->prev = newNode;
-    }
-    current->next = newNode;
-    list->length++;
+void LPUSH_TAIL(struct DoublyLinkedList* list, std::string&& value) {
+    struct LNode* node = list->tail;
+    if (node == nullptr || node->count == LNODE_CAPACITY) node = linkLNode(list, node);
+    insertIntoLNode(list, node, node->count, std::move(value));
+}
+
+void LPUSH_TAIL(struct DoublyLinkedList* list, const std::string& value) {
+    LPUSH_TAIL(list, std::string(value));
+}
+
+bool LINS_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& beforeValue, std::string&& newValue) {
+    struct LNode* node;
+    int slot;
+    if (!findLValue(list, beforeValue, &node, &slot)) return false;
+    insertIntoLNode(list, node, slot, std::move(newValue));
     return true;
 }
 
+bool LINS_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& beforeValue, const std::string& newValue) {
+    return LINS_BEFORE_VALUE(list, beforeValue, std::string(newValue));
+}
+
+bool LINS_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& afterValue, std::string&& newValue) {
+    struct LNode* node;
+    int slot;
+    if (!findLValue(list, afterValue, &node, &slot)) return false;
+    insertIntoLNode(list, node, slot + 1, std::move(newValue));
+    return true;
+}
+
+bool LINS_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& afterValue, const std::string& newValue) {
+    return LINS_AFTER_VALUE(list, afterValue, std::string(newValue));
+}
+
 std::string LDEL_HEAD(struct DoublyLinkedList* list) {
-    if (list->head == nullptr) throw std::runtime_error("Doubly Linked List is empty.");
-    std::string data = list->head->data;
-    struct LNode* temp = list->head;
-    list->head = list->head->next;
-    if (list->head != nullptr) {
-        list->head->prev = nullptr;
-    } else {
-        list->tail = nullptr;
-    }
-    delete temp;
-    list->length--;
-    return data;
+    if (list->head == nullptr) throw std::underflow_error("Doubly Linked List is empty.");
+    return eraseFromLNode(list, list->head, 0);
 }
 
 std::string LDEL_TAIL(struct DoublyLinkedList* list) {
-    if (list->tail == nullptr) throw std::runtime_error("Doubly Linked List is empty.");
-    std::string data = list->tail->data;
-    struct LNode* temp = list->tail;
-    list->tail = list->tail->prev;
-    if (list->tail != nullptr) {
-        list->tail->next = nullptr;
-    } else {
-        list->head = nullptr;
-    }
-    delete temp;
-    list->length--;
-    return data;
+    if (list->tail == nullptr) throw std::underflow_error("Doubly Linked List is empty.");
+    return eraseFromLNode(list, list->tail, list->tail->count - 1);
 }
 
 bool LDEL_BY_VALUE(struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* current = list->head;
-    while (current != nullptr && current->data != value) {
-        current = current->next;
-    }
-    if (current == nullptr) return false;
-    if (current->prev != nullptr) {
-        current->prev->next = current->next;
-    } else {
-        list->head = current->next;
-    }
-    if (current->next != nullptr) {
-        current->next->prev = current->prev;
-    } else {
-        list->tail = current->prev;
-    }
-    delete current;
-    list->length--;
+    struct LNode* node;
+    int slot;
+    if (!findLValue(list, value, &node, &slot)) return false;
+    eraseFromLNode(list, node, slot);
     return true;
 }
 
 bool LDEL_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* target = list->head;
-    while (target != nullptr && target->data != value) {
-        target = target->next;
-    }
-
-    if (target == nullptr || target->prev == nullptr) {
-        return false;
-    }
-
-    struct LNode* toDelete = target->prev;
-
-    if (toDelete->prev != nullptr) {
-        toDelete->prev->next = target;
-    } else {
-        list->head = target;
-    }
-    target->prev = toDelete->prev;
-
-    delete toDelete;
-    list->length--;
+    struct LNode* node;
+    int slot;
+    if (!findLValue(list, value, &node, &slot)) return false;
+    if (slot > 0) eraseFromLNode(list, node, slot - 1);
+    else if (node->prev) eraseFromLNode(list, node->prev, node->prev->count - 1);
+    else return false;
     return true;
 }
 
 bool LDEL_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* target = list->head;
-    while (target != nullptr && target->data != value) {
-        target = target->next;
-    }
-
-    if (target == nullptr || target->next == nullptr) {
-        return false;
-    }
-
-    struct LNode* toDelete = target->next;
-
-    if (toDelete->next != nullptr) {
-        toDelete->next->prev = target;
-    } else {
-        list->tail = target;
-    }
-    target->next = toDelete->next;
-
-    delete toDelete;
-    list->length--;
+    struct LNode* node;
+    int slot;
+    if (!findLValue(list, value, &node, &slot)) return false;
+    if (slot + 1 < node->count) eraseFromLNode(list, node, slot + 1);
+    else if (node->next) eraseFromLNode(list, node->next, 0);
+    else return false;
     return true;
 }
 
 std::string LGET_HEAD(const struct DoublyLinkedList* list) {
-    if (list->head == nullptr) throw std::runtime_error("Doubly Linked List is empty.");
-    return list->head->data;
+    if (list->head == nullptr) throw std::underflow_error("Doubly Linked List is empty.");
+    return list->head->values[0];
 }
 
 std::string LGET_TAIL(const struct DoublyLinkedList* list) {
-    if (list->tail == nullptr) throw std::runtime_error("Doubly Linked List is empty.");
-    return list->tail->data;
+    if (list->tail == nullptr) throw std::underflow_error("Doubly Linked List is empty.");
+    return list->tail->values[list->tail->count - 1];
 }
 
-std::string LGET_AT(const struct DoublyLinkedList* list, int index) {
+std::string LGET_AT(const struct DoublyLinkedList* list, int64_t index) {
     if (index < 0 || index >= list->length) throw std::out_of_range("Invalid index.");
-    struct LNode* current = list->head;
-    for(int i = 0; i < index; ++i) {
-        current = current->next;
-    }
-    return current->data;
+    int slot;
+    struct LNode* node = locateLIndex(list, index, &slot);
+    return node->values[slot];
 }
 
-bool LIS_MEMBER(const struct DoublyLinkedList* list, const std::string& value) {
-    struct LNode* current = list->head;
-    while (current != nullptr) {
-        if (current->data == value) return true;
-        current = current->next;
-    }
-    return false;
+bool LIS_MEMBER(struct DoublyLinkedList* list, const std::string& value) {
+    return scanList(list, value, 1, nullptr).matches > 0;
 }
 
-void LPRINT(const struct DoublyLinkedList* list) {
-    struct LNode* current = list->head;
-    while (current != nullptr) {
-        std::cout << current->data << (current->next != nullptr ? " " : "");
-        current = current->next;
+int64_t LCOUNT(struct DoublyLinkedList* list, const std::string& value) {
+    return scanList(list, value, SCAN_ALL, nullptr).matches;
+}
+
+std::vector<int64_t> LFIND_ALL(struct DoublyLinkedList* list, const std::string& value) {
+    std::vector<int64_t> positions;
+    scanList(list, value, SCAN_ALL, &positions);
+    return positions;
+}
+
+void LPRINT(const struct DoublyLinkedList* list, struct OutputBuffer* out) {
+    LPRINT_PAGE(list, 0, list->length, out);
+}
+
+void LPRINT_PAGE(const struct DoublyLinkedList* list, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(list->length, offset, limit);
+    replyArrayBegin(out, count);
+    if (count > 0) {
+        int slot;
+        struct LNode* current = locateLIndex(list, offset, &slot);
+        for (int64_t i = 0; i < count; ++i) {
+            replyArrayItem(out, current->values[slot]);
+            if (++slot == current->count) {
+                current = current->next;
+                slot = 0;
+            }
+        }
     }
-    std::cout << std::endl;
+    replyArrayEnd(out);
 }
 
 void SCREATE(struct Stack* stack) {
-    stack->top = nullptr;
-    stack->count = 0;
+    MCREATE(&stack->items);
 }
 
 void SDESTROY(struct Stack* stack) {
-    struct FNode* current = stack->top;
-    while (current != nullptr) {
-        struct FNode* next = current->next;
-        delete current;
-        current = next;
-    }
-    SCREATE(stack);
+    MDESTROY(&stack->items);
+}
+
+void SPUSH(struct Stack* stack, std::string&& value) {
+    MPUSH_BACK(&stack->items, std::move(value));
 }
 
 void SPUSH(struct Stack* stack, const std::string& value) {
-    struct FNode* newNode = createFNode(value);
-    newNode->next = stack->top;
-    stack->top = newNode;
-    stack->count++;
+    MPUSH_BACK(&stack->items, value);
 }
 
 std::string SPOP(struct Stack* stack) {
-    if (stack->top == nullptr) throw std::runtime_error("Stack is empty.");
-    std::string data = stack->top->data;
-    struct FNode* temp = stack->top;
-    stack->top = stack->top->next;
-    delete temp;
-    stack->count--;
-    return data;
+    if (stack->items.size == 0) throw std::underflow_error("Stack is empty.");
+    return MDEL_AT(&stack->items, stack->items.size - 1);
 }
 
 std::string SPEEK(const struct Stack* stack) {
-    if (stack->top == nullptr) throw std::runtime_error("Stack is empty.");
-    return stack->top->data;
+    if (stack->items.size == 0) throw std::underflow_error("Stack is empty.");
+    return stack->items.elements[stack->items.size - 1];
 }
 
-int SLENGTH(const struct Stack* stack) {
-    return stack->count;
+int64_t SLENGTH(const struct Stack* stack) {
+    return stack->items.size;
 }
 
-void SPRINT(const struct Stack* stack) {
-    struct FNode* current = stack->top;
-    while (current != nullptr) {
-        std::cout << current->data << (current->next != nullptr ? " " : "");
-        current = current->next;
+void SPRINT(const struct Stack* stack, struct OutputBuffer* out) {
+    SPRINT_PAGE(stack, 0, stack->items.size, out);
+}
+
+// Печать идёт от вершины, то есть с конца массива.
+void SPRINT_PAGE(const struct Stack* stack, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(stack->items.size, offset, limit);
+    replyArrayBegin(out, count);
+    for (int64_t i = stack->items.size - 1 - offset; i > stack->items.size - 1 - offset - count; --i) {
+        replyArrayItem(out, stack->items.elements[i]);
     }
-    std::cout << std::endl;
+    replyArrayEnd(out);
 }
 
 void QCREATE(struct Queue* queue) {
@@ -595,8 +928,8 @@ void QDESTROY(struct Queue* queue) {
     QCREATE(queue);
 }
 
-void QPUSH(struct Queue* queue, const std::string& value) {
-    struct FNode* newNode = createFNode(value);
+void QPUSH(struct Queue* queue, std::string&& value) {
+    struct FNode* newNode = createFNode(std::move(value));
     if (queue->rear == nullptr) {
         queue->front = queue->rear = newNode;
     } else {
@@ -606,9 +939,13 @@ void QPUSH(struct Queue* queue, const std::string& value) {
     queue->count++;
 }
 
+void QPUSH(struct Queue* queue, const std::string& value) {
+    QPUSH(queue, std::string(value));
+}
+
 std::string QPOP(struct Queue* queue) {
-    if (queue->front == nullptr) throw std::runtime_error("Queue is empty.");
-    std::string data = queue->front->data;
+    if (queue->front == nullptr) throw std::underflow_error("Queue is empty.");
+    std::string data = std::move(queue->front->data);
     struct FNode* temp = queue->front;
     queue->front = queue->front->next;
     if (queue->front == nullptr) {
@@ -620,34 +957,102 @@ std::string QPOP(struct Queue* queue) {
 }
 
 std::string QPEEK(const struct Queue* queue) {
-    if (queue->front == nullptr) throw std::runtime_error("Queue is empty.");
+    if (queue->front == nullptr) throw std::underflow_error("Queue is empty.");
     return queue->front->data;
 }
 
-int QLENGTH(const struct Queue* queue) {
+int64_t QLENGTH(const struct Queue* queue) {
     return queue->count;
 }
 
-void QPRINT(const struct Queue* queue) {
+void QPRINT(const struct Queue* queue, struct OutputBuffer* out) {
+    QPRINT_PAGE(queue, 0, queue->count, out);
+}
+
+void QPRINT_PAGE(const struct Queue* queue, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(queue->count, offset, limit);
+    replyArrayBegin(out, count);
     struct FNode* current = queue->front;
-    while (current != nullptr) {
-        std::cout << current->data << (current->next != nullptr ? " " : "");
+    for (int64_t i = 0; i < offset; ++i) current = current->next;
+    for (int64_t i = 0; i < count; ++i) {
+        replyArrayItem(out, current->data);
         current = current->next;
     }
-    std::cout << std::endl;
+    replyArrayEnd(out);
 }
 
 void TCREATE(struct AVLTree* tree) {
     tree->root = nullptr;
+    tree->count = 0;
+    tree->pool.blocks.clear();
+    tree->pool.freeList = nullptr;
+    tree->pool.unused = 0;
 }
 
-int getHeight(struct TNode* node) {
+static uint64_t keyPrefix(std::string_view value) {
+    uint64_t prefix = 0;
+    size_t length = std::min<size_t>(value.size(), sizeof(prefix));
+    for (size_t i = 0; i < sizeof(prefix); ++i) {
+        prefix = (prefix << 8) | (i < length ? static_cast<unsigned char>(value[i]) : 0);
+    }
+    return prefix;
+}
+
+// Порядок совпадает с std::string::compare: если префиксы с нулевым дополнением различаются,
+// они уже решают сравнение, иначе сравниваются ключи целиком.
+static int compareKey(const std::string& value, uint64_t prefix, const struct TNode* node) {
+    if (prefix != node->prefix) return prefix < node->prefix ? -1 : 1;
+    return value.compare(node->data);
+}
+
+template <typename Value>
+static struct TNode* allocateTNode(struct AVLTree* tree, Value&& value, uint64_t prefix) {
+    struct TNodePool* pool = &tree->pool;
+    struct TNode* node = pool->freeList;
+    if (node != nullptr) {
+        pool->freeList = node->left;
+    } else {
+        if (pool->unused == 0) {
+            // Место в blocks - до выделения блока, чтобы push_back уже не мог бросить и потерять его.
+            pool->blocks.reserve(pool->blocks.size() + 1);
+            pool->blocks.push_back(static_cast<struct TNode*>(::operator new(sizeof(struct TNode) * TNODE_BLOCK, std::align_val_t(alignof(struct TNode)))));
+            pool->unused = TNODE_BLOCK;
+        }
+        node = &pool->blocks.back()[TNODE_BLOCK - pool->unused--];
+    }
+    new (&node->data) std::string(std::forward<Value>(value));
+    node->prefix = prefix;
+    node->height = 1;
+    node->size = 1;
+    node->left = node->right = nullptr;
+    return node;
+}
+
+static void releaseTNode(struct AVLTree* tree, struct TNode* node) {
+    node->data.~basic_string();
+    node->left = tree->pool.freeList;
+    tree->pool.freeList = node;
+}
+
+static void releaseTNodePool(struct TNodePool* pool) {
+    for (struct TNode* block : pool->blocks) ::operator delete(block, std::align_val_t(alignof(struct TNode)));
+    pool->blocks.clear();
+    pool->freeList = nullptr;
+    pool->unused = 0;
+}
+
+int getHeight(struct TNode* node) {
     return (node == nullptr) ? 0 : node->height;
 }
 
+int64_t getSize(struct TNode* node) {
+    return (node == nullptr) ? 0 : node->size;
+}
+
 void updateHeight(struct TNode* node) {
     if (node != nullptr) {
         node->height = 1 + std::max(getHeight(node->left), getHeight(node->right));
+        node->size = static_cast<uint64_t>(1 + getSize(node->left) + getSize(node->right));
     }
 }
 
@@ -656,6 +1061,7 @@ int getBalanceFactor(struct TNode* node) {
 }
 
 struct TNode* rightRotate(struct TNode* y) {
+    PROFILE_COUNT(rotations, 1);
     struct TNode* x = y->left;
     struct TNode* T2 = x->right;
     x->right = y;
@@ -666,6 +1072,7 @@ struct TNode* rightRotate(struct TNode* y) {
 }
 
 struct TNode* leftRotate(struct TNode* x) {
+    PROFILE_COUNT(rotations, 1);
     struct TNode* y = x->right;
     struct TNode* T2 = y->left;
     y->left = x;
@@ -691,92 +1098,1145 @@ struct TNode* balanceNode(struct TNode* node) {
     return node;
 }
 
-struct TNode* TINSERT_recursive(struct TNode* node, const std::string& value) {
+// Ключ копируется (или перемещается, если value - rvalue) только в новый узел.
+template <typename Value>
+static struct TNode* TINSERT_recursive(struct AVLTree* tree, struct TNode* node, Value&& value, uint64_t prefix, bool& inserted) {
     if (node == nullptr) {
-        struct TNode* newNode = new struct TNode;
-        newNode->data = value;
-        newNode->height = 1;
-        newNode->left = newNode->right = nullptr;
-        return newNode;
-    }
-    if (value < node->data) node->left = TINSERT_recursive(node->left, value);
-    else if (value > node->data) node->right = TINSERT_recursive(node->right, value);
+        inserted = true;
+        return allocateTNode(tree, std::forward<Value>(value), prefix);
+    }
+    PROFILE_COUNT(nodesVisited, 1);
+    PROFILE_COUNT(comparisons, 1);
+    int order = compareKey(value, prefix, node);
+    if (order < 0) node->left = TINSERT_recursive(tree, node->left, std::forward<Value>(value), prefix, inserted);
+    else if (order > 0) node->right = TINSERT_recursive(tree, node->right, std::forward<Value>(value), prefix, inserted);
     else return node;
     return balanceNode(node);
 }
 
+void TINSERT(struct AVLTree* tree, std::string&& value) {
+    bool inserted = false;
+    uint64_t prefix = keyPrefix(value);
+    tree->root = TINSERT_recursive(tree, tree->root, std::move(value), prefix, inserted);
+    if (inserted) tree->count++;
+}
+
 void TINSERT(struct AVLTree* tree, const std::string& value) {
-    tree->root = TINSERT_recursive(tree->root, value);
+    bool inserted = false;
+    tree->root = TINSERT_recursive(tree, tree->root, value, keyPrefix(value), inserted);
+    if (inserted) tree->count++;
 }
 
-struct TNode* findMinValueNode(struct TNode* node) {
-    struct TNode* current = node;
-    while (current->left != nullptr) current = current->left;
-    return current;
+struct TNode* detachMinNode(struct TNode* node, struct TNode** minNode) {
+    if (node->left == nullptr) {
+        *minNode = node;
+        return node->right;
+    }
+    node->left = detachMinNode(node->left, minNode);
+    return balanceNode(node);
 }
 
-struct TNode* TDEL_recursive(struct TNode* root, const std::string& value, bool& deleted) {
+struct TNode* TDEL_recursive(struct AVLTree* tree, struct TNode* root, const std::string& value, uint64_t prefix, bool& deleted) {
     if (root == nullptr) return root;
-    if (value < root->data) root->left = TDEL_recursive(root->left, value, deleted);
-    else if (value > root->data) root->right = TDEL_recursive(root->right, value, deleted);
+    PROFILE_COUNT(nodesVisited, 1);
+    PROFILE_COUNT(comparisons, 1);
+    int order = compareKey(value, prefix, root);
+    if (order < 0) root->left = TDEL_recursive(tree, root->left, value, prefix, deleted);
+    else if (order > 0) root->right = TDEL_recursive(tree, root->right, value, prefix, deleted);
     else {
         deleted = true;
         if ((root->left == nullptr) || (root->right == nullptr)) {
-            struct TNode* temp = root->left ? root->left : root->right;
-            if (temp == nullptr) {
-                temp = root;
-                root = nullptr;
-            } else *root = *temp;
-            delete temp;
-        } else {
-            struct TNode* temp = findMinValueNode(root->right);
-            root->data = temp->data;
-            bool tempDeleted = false;
-            root->right = TDEL_recursive(root->right, temp->data, tempDeleted);
+            struct TNode* child = root->left ? root->left : root->right;
+            releaseTNode(tree, root);
+            return child;
         }
+        // Преемник вынимается из правого поддерева, и его ключ переезжает в этот узел без копии.
+        struct TNode* successor = nullptr;
+        root->right = detachMinNode(root->right, &successor);
+        root->data = std::move(successor->data);
+        root->prefix = successor->prefix;
+        releaseTNode(tree, successor);
     }
-    if (root == nullptr) return root;
     return balanceNode(root);
 }
 
 bool TDEL(struct AVLTree* tree, const std::string& value) {
     bool deleted = false;
-    tree->root = TDEL_recursive(tree->root, value, deleted);
+    tree->root = TDEL_recursive(tree, tree->root, value, keyPrefix(value), deleted);
+    if (deleted) tree->count--;
+    if (tree->count == 0) releaseTNodePool(&tree->pool);
     return deleted;
 }
 
-struct TNode* TGET_recursive(struct TNode* node, const std::string& value) {
-    if (node == nullptr || node->data == value) return node;
-    if (value < node->data) return TGET_recursive(node->left, value);
-    return TGET_recursive(node->right, value);
+bool TIS_MEMBER(const struct AVLTree* tree, const std::string& value) {
+    uint64_t prefix = keyPrefix(value);
+    for (const struct TNode* node = tree->root; node != nullptr;) {
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
+        int order = compareKey(value, prefix, node);
+        if (order == 0) return true;
+        node = order < 0 ? node->left : node->right;
+    }
+    return false;
 }
 
-bool TIS_MEMBER(const struct AVLTree* tree, const std::string& value) {
-    return TGET_recursive(tree->root, value) != nullptr;
+int64_t TLENGTH(const struct AVLTree* tree) {
+    return tree->count;
+}
+
+void TPRINT(const struct AVLTree* tree, struct OutputBuffer* out) {
+    TPRINT_PAGE(tree, 0, tree->count, out);
+}
+
+// Спуск к элементу с номером offset по размерам поддеревьев (O(log n)); на стеке остаются
+// предки, в которые ещё предстоит вернуться, поэтому дальше обход идёт без повторных посещений.
+template <typename Node>
+void printTreePage(const Node* root, int64_t total, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(total, offset, limit);
+    replyArrayBegin(out, count);
+    std::vector<const Node*> path;
+    const Node* current = root;
+    int64_t skip = offset;
+    while (current != nullptr && count > 0) {
+        int64_t leftSize = current->left ? current->left->size : 0;
+        if (skip < leftSize) {
+            path.push_back(current);
+            current = current->left;
+        } else if (skip == leftSize) {
+            path.push_back(current);
+            break;
+        } else {
+            skip -= leftSize + 1;
+            current = current->right;
+        }
+    }
+    for (int64_t i = 0; i < count; ++i) {
+        current = path.back();
+        path.pop_back();
+        replyArrayItem(out, current->data);
+        for (current = current->right; current != nullptr; current = current->left) path.push_back(current);
+    }
+    replyArrayEnd(out);
+}
+
+void TPRINT_PAGE(const struct AVLTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    printTreePage(tree->root, tree->count, offset, limit, out);
 }
 
-void TPRINT_inorder(struct TNode* root) {
-    if (root != nullptr) {
-        TPRINT_inorder(root->left);
-        std::cout << root->data << " ";
-        TPRINT_inorder(root->right);
+// Память узлов принадлежит блокам пула, поэтому обходу достаточно разрушить ключи.
+void TDESTROY(struct AVLTree* tree) {
+    std::vector<struct TNode*> pending;
+    if (tree->root != nullptr) pending.push_back(tree->root);
+    while (!pending.empty()) {
+        struct TNode* node = pending.back();
+        pending.pop_back();
+        if (node->left != nullptr) pending.push_back(node->left);
+        if (node->right != nullptr) pending.push_back(node->right);
+        node->data.~basic_string();
     }
+    releaseTNodePool(&tree->pool);
+    TCREATE(tree);
 }
 
-void TPRINT(const struct AVLTree* tree) {
-    TPRINT_inorder(tree->root);
-    std::cout << std::endl;
+// Упорядочивает узлы двух деревьев так же, как compareKey - ключ с узлом.
+static int compareNodes(const struct TNode* left, const struct TNode* right) {
+    PROFILE_COUNT(comparisons, 1);
+    if (left->prefix != right->prefix) return left->prefix < right->prefix ? -1 : 1;
+    return left->data.compare(right->data);
 }
 
-void TDESTROY_recursive(struct TNode* node) {
-    if (node != nullptr) {
-        TDESTROY_recursive(node->left);
-        TDESTROY_recursive(node->right);
+// Обход по возрастанию на явном стеке: path хранит левую ветку ещё не выданных предков.
+static void pushLeftPath(std::vector<const struct TNode*>* path, const struct TNode* node) {
+    for (; node != nullptr; node = node->left) path->push_back(node);
+}
+
+static const struct TNode* nextInOrder(std::vector<const struct TNode*>* path) {
+    if (path->empty()) return nullptr;
+    const struct TNode* node = path->back();
+    path->pop_back();
+    pushLeftPath(path, node->right);
+    PROFILE_COUNT(nodesVisited, 1);
+    return node;
+}
+
+// Связывает nodes[from, to) в идеально сбалансированное поддерево: середина - корень, половины
+// отличаются по размеру не больше чем на узел, поэтому условие АВЛ выполнено без поворотов.
+static struct TNode* linkBalanced(struct TNode** nodes, int64_t from, int64_t to) {
+    if (from >= to) return nullptr;
+    int64_t middle = from + (to - from) / 2;
+    struct TNode* node = nodes[middle];
+    node->left = linkBalanced(nodes, from, middle);
+    node->right = linkBalanced(nodes, middle + 1, to);
+    updateHeight(node);
+    return node;
+}
+
+// Собирает дерево из узлов его пула, выделяемых по возрастанию ключей. Пока link() не вызван,
+// узлы ни к чему не привязаны; если сборка прервётся исключением, деструктор свяжет уже
+// выделенные узлы и освободит дерево вместе с блоками пула.
+struct TreeBuildGuard {
+    struct AVLTree* tree;
+    std::vector<struct TNode*> nodes;
+    bool linked;
+
+    TreeBuildGuard(struct AVLTree* target, size_t expected) : tree(target), linked(false) {
+        nodes.reserve(expected);
+    }
+
+    ~TreeBuildGuard() {
+        if (linked) return;
+        link();
+        TDESTROY(tree);
+    }
+
+    TreeBuildGuard(const TreeBuildGuard&) = delete;
+    TreeBuildGuard& operator=(const TreeBuildGuard&) = delete;
+
+    // Место под указатель - до выделения узла, чтобы push_back уже не мог бросить и потерять его.
+    template <typename Value>
+    void append(Value&& value, uint64_t prefix) {
+        if (nodes.size() == nodes.capacity()) nodes.reserve(nodes.size() * 2 + 1);
+        nodes.push_back(allocateTNode(tree, std::forward<Value>(value), prefix));
+    }
+
+    void link() {
+        tree->count = static_cast<int64_t>(nodes.size());
+        tree->root = linkBalanced(nodes.data(), 0, tree->count);
+        linked = true;
+    }
+};
+
+// Слияние двух упорядоченных последовательностей за O(|a| + |b|): keep решает по тому, в каком
+// из деревьев есть ключ, попадёт ли он в результат. Узлы результата берутся из пула подряд
+// в порядке ключей, дерево собирается без сравнений и поворотов и заменяет содержимое dst
+// (dst может совпадать с a или b) только после успешной сборки.
+template <typename Keep>
+static void mergeTrees(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b, Keep keep) {
+    struct AVLTree result;
+    TCREATE(&result);
+    {
+        TreeBuildGuard build(&result, 0);
+        std::vector<const struct TNode*> left, right;
+        pushLeftPath(&left, a->root);
+        pushLeftPath(&right, b->root);
+        const struct TNode* x = nextInOrder(&left);
+        const struct TNode* y = nextInOrder(&right);
+        while (x != nullptr || y != nullptr) {
+            int order = x == nullptr ? 1 : y == nullptr ? -1 : compareNodes(x, y);
+            const struct TNode* node = order <= 0 ? x : y;
+            if (keep(order <= 0, order >= 0)) build.append(node->data, node->prefix);
+            if (order <= 0) x = nextInOrder(&left);
+            if (order >= 0) y = nextInOrder(&right);
+        }
+        build.link();
+    }
+    TDESTROY(dst);
+    *dst = std::move(result);
+}
+
+void TUNION(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b) {
+    mergeTrees(dst, a, b, [](bool, bool) { return true; });
+}
+
+void TINTERSECT(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b) {
+    mergeTrees(dst, a, b, [](bool inA, bool inB) { return inA && inB; });
+}
+
+void TDIFF(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b) {
+    mergeTrees(dst, a, b, [](bool inA, bool inB) { return inA && !inB; });
+}
+
+// Порядок TNode (сначала префикс, затем строка) совпадает с обычным порядком строк,
+// поэтому одна проверка годится и для TREE, и для VTREE.
+static bool strictlyAscending(const std::vector<std::string_view>& values) {
+    for (size_t i = 1; i < values.size(); ++i) {
+        if (values[i - 1].compare(values[i]) >= 0) return false;
+    }
+    return true;
+}
+
+// Порядок проверяется до выделения узлов; если выделение бросит, дерево останется пустым.
+bool TLOAD_SORTED(struct AVLTree* tree, const std::vector<std::string_view>& values) {
+    if (tree->count != 0 || !strictlyAscending(values)) return false;
+    TreeBuildGuard build(tree, values.size());
+    for (std::string_view value : values) build.append(value, keyPrefix(value));
+    build.link();
+    return true;
+}
+
+struct BNode* createBNode(bool isLeaf) {
+    struct BNode* node = new struct BNode;
+    node->isLeaf = isLeaf;
+    node->count = 0;
+    node->children = isLeaf ? nullptr : new struct BNode*[BTREE_ORDER + 2];
+    node->next = nullptr;
+    return node;
+}
+
+void destroyBNode(struct BNode* root) {
+    std::vector<struct BNode*> pending(1, root);
+    while (!pending.empty()) {
+        struct BNode* node = pending.back();
+        pending.pop_back();
+        if (!node->isLeaf) {
+            pending.insert(pending.end(), node->children, node->children + node->count + 1);
+            delete[] node->children;
+        }
         delete node;
     }
 }
 
-void TDESTROY(struct AVLTree* tree) {
-    TDESTROY_recursive(tree->root);
-    TCREATE(tree);
-}
\ No newline at end of file
+int BLOWER_BOUND(const struct BNode* node, const std::string& value) {
+    PROFILE_COUNT(nodesVisited, 1);
+    return static_cast<int>(std::lower_bound(node->keys, node->keys + node->count, value, countedLess) - node->keys);
+}
+
+int BCHILD_INDEX(const struct BNode* node, const std::string& value) {
+    PROFILE_COUNT(nodesVisited, 1);
+    return static_cast<int>(std::upper_bound(node->keys, node->keys + node->count, value, countedLess) - node->keys);
+}
+
+void BCREATE(struct BPlusTree* tree) {
+    tree->root = createBNode(true);
+    tree->firstLeaf = tree->root;
+    tree->count = 0;
+}
+
+void BDESTROY(struct BPlusTree* tree) {
+    if (tree->root != nullptr) destroyBNode(tree->root);
+    tree->root = tree->firstLeaf = nullptr;
+    tree->count = 0;
+}
+
+// Возвращает правую половину, если узел переполнился и был расщеплён; разделитель - в separator.
+template <typename Value>
+static struct BNode* BINSERT_recursive(struct BNode* node, Value&& value, std::string& separator, bool& inserted) {
+    if (node->isLeaf) {
+        int i = BLOWER_BOUND(node, value);
+        if (i < node->count && node->keys[i] == value) return nullptr;
+        std::move_backward(node->keys + i, node->keys + node->count, node->keys + node->count + 1);
+        node->keys[i] = std::forward<Value>(value);
+        node->count++;
+        inserted = true;
+        if (node->count <= BTREE_ORDER) return nullptr;
+
+        struct BNode* right = createBNode(true);
+        int middle = node->count / 2;
+        std::move(node->keys + middle, node->keys + node->count, right->keys);
+        right->count = node->count - middle;
+        node->count = middle;
+        right->next = node->next;
+        node->next = right;
+        separator = right->keys[0];
+        return right;
+    }
+
+    int i = BCHILD_INDEX(node, value);
+    std::string childSeparator;
+    struct BNode* newChild = BINSERT_recursive(node->children[i], std::forward<Value>(value), childSeparator, inserted);
+    if (newChild == nullptr) return nullptr;
+    std::move_backward(node->keys + i, node->keys + node->count, node->keys + node->count + 1);
+    std::copy_backward(node->children + i + 1, node->children + node->count + 1, node->children + node->count + 2);
+    node->keys[i] = std::move(childSeparator);
+    node->children[i + 1] = newChild;
+    node->count++;
+    if (node->count <= BTREE_ORDER) return nullptr;
+
+    struct BNode* right = createBNode(false);
+    int middle = node->count / 2;
+    separator = std::move(node->keys[middle]);
+    std::move(node->keys + middle + 1, node->keys + node->count, right->keys);
+    std::copy(node->children + middle + 1, node->children + node->count + 1, right->children);
+    right->count = node->count - middle - 1;
+    node->count = middle;
+    return right;
+}
+
+template <typename Value>
+static bool insertBKey(struct BPlusTree* tree, Value&& value) {
+    std::string separator;
+    bool inserted = false;
+    struct BNode* right = BINSERT_recursive(tree->root, std::forward<Value>(value), separator, inserted);
+    if (right != nullptr) {
+        struct BNode* newRoot = createBNode(false);
+        newRoot->keys[0] = std::move(separator);
+        newRoot->children[0] = tree->root;
+        newRoot->children[1] = right;
+        newRoot->count = 1;
+        tree->root = newRoot;
+    }
+    if (inserted) tree->count++;
+    return inserted;
+}
+
+bool BINSERT(struct BPlusTree* tree, std::string&& value) {
+    return insertBKey(tree, std::move(value));
+}
+
+bool BINSERT(struct BPlusTree* tree, const std::string& value) {
+    return insertBKey(tree, value);
+}
+
+// Сливает children[index + 1] в children[index] и убирает разделитель keys[index] из родителя.
+void BMERGE_children(struct BNode* parent, int index) {
+    struct BNode* left = parent->children[index];
+    struct BNode* right = parent->children[index + 1];
+    if (left->isLeaf) {
+        std::move(right->keys, right->keys + right->count, left->keys + left->count);
+        left->count += right->count;
+        left->next = right->next;
+    } else {
+        left->keys[left->count] = std::move(parent->keys[index]);
+        std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+        std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+        left->count += right->count + 1;
+    }
+    if (!right->isLeaf) delete[] right->children;
+    delete right;
+    std::move(parent->keys + index + 1, parent->keys + parent->count, parent->keys + index);
+    std::copy(parent->children + index + 2, parent->children + parent->count + 1, parent->children + index + 1);
+    parent->count--;
+}
+
+void BREBALANCE_child(struct BNode* parent, int index) {
+    struct BNode* child = parent->children[index];
+    if (index > 0 && parent->children[index - 1]->count > BTREE_MIN_KEYS) {
+        struct BNode* left = parent->children[index - 1];
+        std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+        if (child->isLeaf) {
+            child->keys[0] = std::move(left->keys[left->count - 1]);
+            parent->keys[index - 1] = child->keys[0];
+        } else {
+            std::copy_backward(child->children, child->children + child->count + 1, child->children + child->count + 2);
+            child->keys[0] = std::move(parent->keys[index - 1]);
+            child->children[0] = left->children[left->count];
+            parent->keys[index - 1] = std::move(left->keys[left->count - 1]);
+        }
+        child->count++;
+        left->count--;
+    } else if (index < parent->count && parent->children[index + 1]->count > BTREE_MIN_KEYS) {
+        struct BNode* right = parent->children[index + 1];
+        if (child->isLeaf) {
+            child->keys[child->count] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            parent->keys[index] = right->keys[0];
+        } else {
+            child->keys[child->count] = std::move(parent->keys[index]);
+            child->children[child->count + 1] = right->children[0];
+            parent->keys[index] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::copy(right->children + 1, right->children + right->count + 1, right->children);
+        }
+        child->count++;
+        right->count--;
+    } else if (index > 0) {
+        BMERGE_children(parent, index - 1);
+    } else {
+        BMERGE_children(parent, index);
+    }
+}
+
+bool BDEL_recursive(struct BNode* node, const std::string& value) {
+    if (node->isLeaf) {
+        int i = BLOWER_BOUND(node, value);
+        if (i >= node->count || node->keys[i] != value) return false;
+        std::move(node->keys + i + 1, node->keys + node->count, node->keys + i);
+        node->count--;
+        return true;
+    }
+    int i = BCHILD_INDEX(node, value);
+    if (!BDEL_recursive(node->children[i], value)) return false;
+    if (node->children[i]->count < BTREE_MIN_KEYS) BREBALANCE_child(node, i);
+    return true;
+}
+
+bool BDEL(struct BPlusTree* tree, const std::string& value) {
+    if (!BDEL_recursive(tree->root, value)) return false;
+    if (!tree->root->isLeaf && tree->root->count == 0) {
+        struct BNode* oldRoot = tree->root;
+        tree->root = oldRoot->children[0];
+        delete[] oldRoot->children;
+        delete oldRoot;
+    }
+    tree->count--;
+    return true;
+}
+
+const struct BNode* BFIND_leaf(const struct BPlusTree* tree, const std::string& value) {
+    const struct BNode* node = tree->root;
+    while (!node->isLeaf) node = node->children[BCHILD_INDEX(node, value)];
+    return node;
+}
+
+bool BIS_MEMBER(const struct BPlusTree* tree, const std::string& value) {
+    const struct BNode* leaf = BFIND_leaf(tree, value);
+    int i = BLOWER_BOUND(leaf, value);
+    return i < leaf->count && leaf->keys[i] == value;
+}
+
+int64_t BLENGTH(const struct BPlusTree* tree) {
+    return tree->count;
+}
+
+// Листья связаны в список, поэтому диапазон - это один спуск и последовательный проход.
+void BRANGE(const struct BPlusTree* tree, const std::string& from, const std::string& to, struct OutputBuffer* out) {
+    std::vector<const std::string*> values;
+    const struct BNode* leaf = BFIND_leaf(tree, from);
+    int i = BLOWER_BOUND(leaf, from);
+    while (leaf != nullptr) {
+        for (; i < leaf->count && !(to < leaf->keys[i]); ++i) values.push_back(&leaf->keys[i]);
+        if (i < leaf->count) break;
+        leaf = leaf->next;
+        i = 0;
+    }
+    replyArrayBegin(out, values.size());
+    for (const std::string* value : values) replyArrayItem(out, *value);
+    replyArrayEnd(out);
+}
+
+void BPRINT(const struct BPlusTree* tree, struct OutputBuffer* out) {
+    BPRINT_PAGE(tree, 0, tree->count, out);
+}
+
+void BPRINT_PAGE(const struct BPlusTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(tree->count, offset, limit);
+    replyArrayBegin(out, count);
+    const struct BNode* leaf = tree->firstLeaf;
+    while (leaf != nullptr && offset >= leaf->count) {
+        offset -= leaf->count;
+        leaf = leaf->next;
+    }
+    for (int64_t printed = 0; printed < count; leaf = leaf->next, offset = 0) {
+        for (int64_t i = offset; i < leaf->count && printed < count; ++i, ++printed) replyArrayItem(out, leaf->keys[i]);
+    }
+    replyArrayEnd(out);
+}
+
+unsigned HGROUP_match(const signed char* group, signed char tag) {
+#if defined(__SSE2__)
+    __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(tag))));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < HSET_GROUP_WIDTH; ++i) {
+        if (group[i] == tag) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Свободные и удалённые слоты - единственные с установленным старшим битом.
+unsigned HGROUP_match_free(const signed char* group) {
+#if defined(__SSE2__)
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < HSET_GROUP_WIDTH; ++i) {
+        if (group[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+size_t HHASH(const std::string& value) {
+    return std::hash<std::string>()(value);
+}
+
+signed char HTAG(size_t hash) {
+    return static_cast<signed char>(hash & 0x7F);
+}
+
+// Поля таблицы меняются только после успешного выделения: при bad_alloc она остаётся прежней.
+void HTABLE_init(struct HashTable* table, int64_t capacity) {
+    signed char* control = nullptr;
+    std::string* slots = nullptr;
+    if (capacity != 0) {
+        control = new signed char[capacity];
+        std::fill(control, control + capacity, static_cast<signed char>(HSET_EMPTY));
+        // Строки создаются только в занятых слотах, иначе расширение стоило бы capacity конструкторов сразу.
+        try {
+            slots = static_cast<std::string*>(::operator new(sizeof(std::string) * static_cast<size_t>(capacity)));
+        } catch (...) {
+            delete[] control;
+            throw;
+        }
+    }
+    table->capacity = capacity;
+    table->used = 0;
+    table->deleted = 0;
+    table->control = control;
+    table->slots = slots;
+}
+
+void HTABLE_free(struct HashTable* table) {
+    for (int64_t i = 0; i < table->capacity; ++i) {
+        if (table->control[i] >= 0) table->slots[i].~basic_string();
+    }
+    delete[] table->control;
+    ::operator delete(table->slots);
+    HTABLE_init(table, 0);
+}
+
+// Группы перебираются с треугольным шагом: при числе групп - степени двойки обходятся все.
+int64_t HTABLE_find(const struct HashTable* table, const std::string& value, size_t hash) {
+    if (table->capacity == 0) return -1;
+    int64_t groupMask = table->capacity / HSET_GROUP_WIDTH - 1;
+    int64_t group = static_cast<int64_t>((hash >> 7) & static_cast<size_t>(groupMask));
+    for (int64_t step = 0; step <= groupMask; ++step) {
+        const signed char* control = table->control + group * HSET_GROUP_WIDTH;
+        PROFILE_COUNT(nodesVisited, 1);
+        for (unsigned mask = HGROUP_match(control, HTAG(hash)); mask != 0; mask &= mask - 1) {
+            int64_t slot = group * HSET_GROUP_WIDTH + __builtin_ctz(mask);
+            PROFILE_COUNT(comparisons, 1);
+            if (table->slots[slot] == value) return slot;
+        }
+        if (HGROUP_match(control, HSET_EMPTY) != 0) return -1;
+        group = (group + step + 1) & groupMask;
+    }
+    return -1;
+}
+
+// Занимает первый свободный слот на пути поиска; значения там быть не должно.
+int64_t HTABLE_place(struct HashTable* table, size_t hash) {
+    int64_t groupMask = table->capacity / HSET_GROUP_WIDTH - 1;
+    int64_t group = static_cast<int64_t>((hash >> 7) & static_cast<size_t>(groupMask));
+    for (int64_t step = 0; step <= groupMask; ++step) {
+        unsigned mask = HGROUP_match_free(table->control + group * HSET_GROUP_WIDTH);
+        if (mask != 0) {
+            int64_t slot = group * HSET_GROUP_WIDTH + __builtin_ctz(mask);
+            if (table->control[slot] == HSET_DELETED) table->deleted--;
+            table->control[slot] = HTAG(hash);
+            table->used++;
+            return slot;
+        }
+        group = (group + step + 1) & groupMask;
+    }
+    throw std::runtime_error("Hash table is full.");
+}
+
+void HMIGRATE(struct HashSet* set, int64_t steps) {
+    if (set->old.capacity == 0) return;
+    for (; steps > 0 && set->migrated < set->old.capacity; --steps, ++set->migrated) {
+        int64_t slot = set->migrated;
+        if (set->old.control[slot] < 0) continue;
+        int64_t target = HTABLE_place(&set->current, HHASH(set->old.slots[slot]));
+        PROFILE_COUNT(bytesCopied, sizeof(std::string));
+        new (&set->current.slots[target]) std::string(std::move(set->old.slots[slot]));
+        set->old.slots[slot].~basic_string();
+        set->old.control[slot] = HSET_DELETED;
+        set->old.used--;
+    }
+    if (set->migrated == set->old.capacity) HTABLE_free(&set->old);
+}
+
+// Новая таблица вдвое больше, если элементов много, иначе того же размера - чтобы убрать надгробия.
+void HGROW(struct HashSet* set) {
+    PROFILE_COUNT(resizes, 1);
+    HMIGRATE(set, set->old.capacity);
+    int64_t capacity = set->current.capacity;
+    if (set->count >= capacity / 2) capacity *= 2;
+    struct HashTable table;
+    HTABLE_init(&table, capacity);
+    set->old = set->current;
+    set->current = table;
+    set->migrated = 0;
+}
+
+void HCREATE(struct HashSet* set) {
+    HTABLE_init(&set->current, HSET_GROUP_WIDTH);
+    HTABLE_init(&set->old, 0);
+    set->migrated = 0;
+    set->count = 0;
+}
+
+void HDESTROY(struct HashSet* set) {
+    HTABLE_free(&set->current);
+    HTABLE_free(&set->old);
+    set->migrated = 0;
+    set->count = 0;
+}
+
+void HRESERVE(struct HashSet* set, int64_t count) {
+    if (set->count != 0) return;
+    int64_t capacity = HSET_GROUP_WIDTH;
+    while (capacity / 8 * 7 < count) capacity *= 2;
+    if (capacity <= set->current.capacity) return;
+    struct HashTable table;
+    HTABLE_init(&table, capacity);
+    HDESTROY(set);
+    set->current = table;
+}
+
+// Слот для нового значения или -1, если оно уже есть; строку в слоте конструирует вызывающий.
+static int64_t HADD_slot(struct HashSet* set, const std::string& value) {
+    HMIGRATE(set, HSET_MIGRATE_STEP);
+    size_t hash = HHASH(value);
+    if (HTABLE_find(&set->current, value, hash) >= 0 || HTABLE_find(&set->old, value, hash) >= 0) return -1;
+    if (set->current.used + set->current.deleted >= set->current.capacity / 8 * 7) HGROW(set);
+    set->count++;
+    return HTABLE_place(&set->current, hash);
+}
+
+bool HADD(struct HashSet* set, std::string&& value) {
+    int64_t slot = HADD_slot(set, value);
+    if (slot < 0) return false;
+    new (&set->current.slots[slot]) std::string(std::move(value));
+    return true;
+}
+
+bool HADD(struct HashSet* set, const std::string& value) {
+    int64_t slot = HADD_slot(set, value);
+    if (slot < 0) return false;
+    new (&set->current.slots[slot]) std::string(value);
+    return true;
+}
+
+bool HDEL(struct HashSet* set, const std::string& value) {
+    HMIGRATE(set, HSET_MIGRATE_STEP);
+    size_t hash = HHASH(value);
+    struct HashTable* table = &set->current;
+    int64_t slot = HTABLE_find(table, value, hash);
+    if (slot < 0) {
+        table = &set->old;
+        slot = HTABLE_find(table, value, hash);
+        if (slot < 0) return false;
+    }
+    table->slots[slot].~basic_string();
+    table->control[slot] = HSET_DELETED;
+    table->used--;
+    table->deleted++;
+    set->count--;
+    return true;
+}
+
+bool HIS_MEMBER(const struct HashSet* set, const std::string& value) {
+    size_t hash = HHASH(value);
+    return HTABLE_find(&set->current, value, hash) >= 0 || HTABLE_find(&set->old, value, hash) >= 0;
+}
+
+int64_t HLENGTH(const struct HashSet* set) {
+    return set->count;
+}
+
+void HPRINT(const struct HashSet* set, struct OutputBuffer* out) {
+    HPRINT_PAGE(set, 0, set->count, out);
+}
+
+// Порядок - по слотам: сначала новая таблица, затем ещё не перенесённая часть старой.
+void HPRINT_PAGE(const struct HashSet* set, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    int64_t count = pageLength(set->count, offset, limit);
+    replyArrayBegin(out, count);
+    const struct HashTable* tables[2] = {&set->current, &set->old};
+    int64_t printed = 0;
+    for (const struct HashTable* table : tables) {
+        for (int64_t slot = 0; slot < table->capacity && printed < count; ++slot) {
+            if (table->control[slot] < 0) continue;
+            if (offset > 0) { offset--; continue; }
+            replyArrayItem(out, table->slots[slot]);
+            printed++;
+        }
+    }
+    replyArrayEnd(out);
+}
+
+void PSIFT_UP(struct DynamicArray* heap, int64_t index) {
+    std::string value = std::move(heap->elements[index]);
+    while (index > 0) {
+        int64_t parent = (index - 1) / PQUEUE_ARITY;
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, 1);
+        if (!(value < heap->elements[parent])) break;
+        heap->elements[index] = std::move(heap->elements[parent]);
+        index = parent;
+    }
+    heap->elements[index] = std::move(value);
+}
+
+void PSIFT_DOWN(struct DynamicArray* heap, int64_t index) {
+    std::string value = std::move(heap->elements[index]);
+    while (true) {
+        int64_t first = index * PQUEUE_ARITY + 1;
+        if (first >= heap->size) break;
+        int64_t last = std::min<int64_t>(first + PQUEUE_ARITY, heap->size);
+        int64_t smallest = first;
+        PROFILE_COUNT(nodesVisited, 1);
+        PROFILE_COUNT(comparisons, last - first);
+        for (int64_t child = first + 1; child < last; ++child) {
+            if (heap->elements[child] < heap->elements[smallest]) smallest = child;
+        }
+        if (!(heap->elements[smallest] < value)) break;
+        heap->elements[index] = std::move(heap->elements[smallest]);
+        index = smallest;
+    }
+    heap->elements[index] = std::move(value);
+}
+
+void PCREATE(struct PriorityQueue* queue) {
+    MCREATE(&queue->heap);
+}
+
+void PDESTROY(struct PriorityQueue* queue) {
+    MDESTROY(&queue->heap);
+}
+
+void PPUSH(struct PriorityQueue* queue, std::string&& value) {
+    MPUSH_BACK(&queue->heap, std::move(value));
+    PSIFT_UP(&queue->heap, queue->heap.size - 1);
+}
+
+void PPUSH(struct PriorityQueue* queue, const std::string& value) {
+    PPUSH(queue, std::string(value));
+}
+
+// Добавляет в конец без восстановления кучи; после серии вызовов нужен PHEAPIFY.
+void PAPPEND(struct PriorityQueue* queue, std::string&& value) {
+    MPUSH_BACK(&queue->heap, std::move(value));
+}
+
+void PAPPEND(struct PriorityQueue* queue, const std::string& value) {
+    PAPPEND(queue, std::string(value));
+}
+
+// Построение снизу вверх - O(n), в отличие от n вставок по O(log n).
+void PHEAPIFY(struct PriorityQueue* queue) {
+    for (int64_t i = (queue->heap.size - 2) / PQUEUE_ARITY; i >= 0; --i) PSIFT_DOWN(&queue->heap, i);
+}
+
+std::string PPOP(struct PriorityQueue* queue) {
+    struct DynamicArray* heap = &queue->heap;
+    if (heap->size == 0) throw std::underflow_error("Priority Queue is empty.");
+    std::string value = std::move(heap->elements[0]);
+    heap->size--;
+    if (heap->size > 0) {
+        heap->elements[0] = std::move(heap->elements[heap->size]);
+        PSIFT_DOWN(heap, 0);
+    }
+    heap->elements[heap->size].~basic_string();
+    shrinkArray(heap);
+    return value;
+}
+
+std::string PPEEK(const struct PriorityQueue* queue) {
+    if (queue->heap.size == 0) throw std::underflow_error("Priority Queue is empty.");
+    return queue->heap.elements[0];
+}
+
+int64_t PLENGTH(const struct PriorityQueue* queue) {
+    return queue->heap.size;
+}
+
+// k наименьших по возрастанию без изменения кучи: кандидаты - потомки уже выданных
+// элементов, из них каждый раз берётся наименьший. O(k log k) независимо от размера кучи.
+void PTOPK(const struct PriorityQueue* queue, int64_t k, struct OutputBuffer* out) {
+    const struct DynamicArray* heap = &queue->heap;
+    if (k < 0) throw std::out_of_range("Invalid count.");
+    int64_t count = std::min(k, heap->size);
+    auto greater = [heap](int64_t a, int64_t b) { return heap->elements[b] < heap->elements[a]; };
+    std::vector<int64_t> candidates;
+    if (count > 0) candidates.push_back(0);
+    replyArrayBegin(out, count);
+    for (int64_t printed = 0; printed < count; ++printed) {
+        std::pop_heap(candidates.begin(), candidates.end(), greater);
+        int64_t index = candidates.back();
+        candidates.pop_back();
+        replyArrayItem(out, heap->elements[index]);
+        int64_t first = index * PQUEUE_ARITY + 1;
+        for (int64_t child = first; child < first + PQUEUE_ARITY && child < heap->size; ++child) {
+            candidates.push_back(child);
+            std::push_heap(candidates.begin(), candidates.end(), greater);
+        }
+    }
+    replyArrayEnd(out);
+}
+
+void PPRINT(const struct PriorityQueue* queue, struct OutputBuffer* out) {
+    MPRINT(&queue->heap, out);
+}
+
+// Порядок - порядок массива кучи; первым идёт наименьший элемент.
+void PPRINT_PAGE(const struct PriorityQueue* queue, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    MPRINT_PAGE(&queue->heap, offset, limit, out);
+}
+
+int getVHeight(const struct VNode* node) {
+    return (node == nullptr) ? 0 : node->height;
+}
+
+int64_t getVSize(const struct VNode* node) {
+    return (node == nullptr) ? 0 : node->size;
+}
+
+int getVBalanceFactor(const struct VNode* node) {
+    return (node == nullptr) ? 0 : getVHeight(node->left) - getVHeight(node->right);
+}
+
+void updateVNode(struct VNode* node) {
+    node->height = 1 + std::max(getVHeight(node->left), getVHeight(node->right));
+    node->size = 1 + getVSize(node->left) + getVSize(node->right);
+}
+
+template <typename Value>
+static struct VNode* createVNode(Value&& value) {
+    struct VNode* node = new struct VNode;
+    node->data = std::forward<Value>(value);
+    node->height = 1;
+    node->size = 1;
+    node->left = node->right = nullptr;
+    return node;
+}
+
+// Изменять можно только свежие, ещё не опубликованные узлы; опубликованный узел копируется,
+// а оригинал уходит в replaced до освобождения по эпохе.
+struct VNode* copyVNode(const struct VNode* node, std::vector<const struct VNode*>& replaced) {
+    struct VNode* copy = new struct VNode(*node);
+    PROFILE_COUNT(bytesCopied, sizeof(struct VNode) + node->data.size());
+    replaced.push_back(node);
+    return copy;
+}
+
+struct VNode* rotateVRight(struct VNode* y, std::vector<const struct VNode*>& replaced) {
+    PROFILE_COUNT(rotations, 1);
+    struct VNode* x = copyVNode(y->left, replaced);
+    y->left = x->right;
+    updateVNode(y);
+    x->right = y;
+    updateVNode(x);
+    return x;
+}
+
+struct VNode* rotateVLeft(struct VNode* x, std::vector<const struct VNode*>& replaced) {
+    PROFILE_COUNT(rotations, 1);
+    struct VNode* y = copyVNode(x->right, replaced);
+    x->right = y->left;
+    updateVNode(x);
+    y->left = x;
+    updateVNode(y);
+    return y;
+}
+
+struct VNode* balanceVNode(struct VNode* node, std::vector<const struct VNode*>& replaced) {
+    updateVNode(node);
+    int balance = getVBalanceFactor(node);
+    if (balance > 1) {
+        if (getVBalanceFactor(node->left) < 0) node->left = rotateVLeft(copyVNode(node->left, replaced), replaced);
+        return rotateVRight(node, replaced);
+    }
+    if (balance < -1) {
+        if (getVBalanceFactor(node->right) > 0) node->right = rotateVRight(copyVNode(node->right, replaced), replaced);
+        return rotateVLeft(node, replaced);
+    }
+    return node;
+}
+
+template <typename Value>
+static const struct VNode* VINSERT_recursive(const struct VNode* node, Value&& value, bool& inserted, std::vector<const struct VNode*>& replaced) {
+    if (node == nullptr) {
+        inserted = true;
+        return createVNode(std::forward<Value>(value));
+    }
+    PROFILE_COUNT(nodesVisited, 1);
+    PROFILE_COUNT(comparisons, 1);
+    if (value == node->data) return node;
+    bool goLeft = value < node->data;
+    const struct VNode* child = VINSERT_recursive(goLeft ? node->left : node->right, std::forward<Value>(value), inserted, replaced);
+    if (!inserted) return node;
+    struct VNode* copy = copyVNode(node, replaced);
+    if (goLeft) copy->left = child; else copy->right = child;
+    return balanceVNode(copy, replaced);
+}
+
+const struct VNode* VDEL_recursive(const struct VNode* node, const std::string& value, bool& deleted, std::vector<const struct VNode*>& replaced) {
+    if (node == nullptr) return nullptr;
+    PROFILE_COUNT(nodesVisited, 1);
+    PROFILE_COUNT(comparisons, 1);
+    if (value != node->data) {
+        bool goLeft = value < node->data;
+        const struct VNode* child = VDEL_recursive(goLeft ? node->left : node->right, value, deleted, replaced);
+        if (!deleted) return node;
+        struct VNode* copy = copyVNode(node, replaced);
+        if (goLeft) copy->left = child; else copy->right = child;
+        return balanceVNode(copy, replaced);
+    }
+    deleted = true;
+    replaced.push_back(node);
+    if (node->left == nullptr) return node->right;
+    if (node->right == nullptr) return node->left;
+    const struct VNode* successor = node->right;
+    while (successor->left != nullptr) successor = successor->left;
+    struct VNode* copy = createVNode(successor->data);
+    bool successorDeleted = false;
+    copy->left = node->left;
+    copy->right = VDEL_recursive(node->right, successor->data, successorDeleted, replaced);
+    return balanceVNode(copy, replaced);
+}
+
+// Освобождает вытесненные узлы, которые не может видеть ни один активный читатель.
+void reclaimVNodes(struct VersionedTree* tree) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < VTREE_MAX_READERS; ++i) {
+        uint64_t epoch = tree->readerEpochs[i].load();
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < tree->retired.size(); ++i) {
+        if (tree->retired[i].epoch < oldest) {
+            for (const struct VNode* node : tree->retired[i].nodes) delete node;
+        } else {
+            if (kept != i) tree->retired[kept] = std::move(tree->retired[i]);
+            kept++;
+        }
+    }
+    tree->retired.resize(kept);
+}
+
+// Новый корень публикуется до смены эпохи: читатель, объявивший новую эпоху, уже видит новый корень.
+void publishVersion(struct VersionedTree* tree, const struct VNode* root, std::vector<const struct VNode*>& replaced) {
+    tree->root.store(root);
+    uint64_t epoch = tree->epoch.fetch_add(1);
+    tree->retired.push_back({epoch, std::move(replaced)});
+    reclaimVNodes(tree);
+}
+
+void VCREATE(struct VersionedTree* tree) {
+    tree->root.store(nullptr);
+    tree->epoch.store(1);
+    for (int i = 0; i < VTREE_MAX_READERS; ++i) tree->readerEpochs[i].store(0);
+    tree->retired.clear();
+}
+
+// Читателей к этому моменту быть не должно.
+void VDESTROY(struct VersionedTree* tree) {
+    std::vector<const struct VNode*> pending;
+    if (tree->root.load() != nullptr) pending.push_back(tree->root.load());
+    while (!pending.empty()) {
+        const struct VNode* node = pending.back();
+        pending.pop_back();
+        if (node->left != nullptr) pending.push_back(node->left);
+        if (node->right != nullptr) pending.push_back(node->right);
+        delete node;
+    }
+    for (struct RetiredNodes& batch : tree->retired) {
+        for (const struct VNode* node : batch.nodes) delete node;
+    }
+    VCREATE(tree);
+}
+
+template <typename Value>
+static bool insertVKey(struct VersionedTree* tree, Value&& value) {
+    std::lock_guard<std::mutex> lock(tree->writerLock);
+    std::vector<const struct VNode*> replaced;
+    bool inserted = false;
+    const struct VNode* root = VINSERT_recursive(tree->root.load(), std::forward<Value>(value), inserted, replaced);
+    if (inserted) publishVersion(tree, root, replaced);
+    return inserted;
+}
+
+bool VINSERT(struct VersionedTree* tree, std::string&& value) {
+    return insertVKey(tree, std::move(value));
+}
+
+bool VINSERT(struct VersionedTree* tree, const std::string& value) {
+    return insertVKey(tree, value);
+}
+
+static const struct VNode* linkVBalanced(struct VNode** nodes, int64_t from, int64_t to) {
+    if (from >= to) return nullptr;
+    int64_t middle = from + (to - from) / 2;
+    struct VNode* node = nodes[middle];
+    node->left = linkVBalanced(nodes, from, middle);
+    node->right = linkVBalanced(nodes, middle + 1, to);
+    updateVNode(node);
+    return node;
+}
+
+// Узлы собираются в сбалансированное дерево до публикации, и корень публикуется один раз -
+// без копирования путей и без узлов на освобождение по эпохе.
+bool VLOAD_SORTED(struct VersionedTree* tree, const std::vector<std::string_view>& values) {
+    std::lock_guard<std::mutex> lock(tree->writerLock);
+    if (tree->root.load() != nullptr || !strictlyAscending(values)) return false;
+    std::vector<struct VNode*> nodes;
+    nodes.reserve(values.size());
+    try {
+        for (std::string_view value : values) nodes.push_back(createVNode(value));
+    } catch (...) {
+        for (struct VNode* node : nodes) delete node;
+        throw;
+    }
+    std::vector<const struct VNode*> replaced;
+    publishVersion(tree, linkVBalanced(nodes.data(), 0, static_cast<int64_t>(nodes.size())), replaced);
+    return true;
+}
+
+bool VDEL(struct VersionedTree* tree, const std::string& value) {
+    std::lock_guard<std::mutex> lock(tree->writerLock);
+    std::vector<const struct VNode*> replaced;
+    bool deleted = false;
+    const struct VNode* root = VDEL_recursive(tree->root.load(), value, deleted, replaced);
+    if (deleted) publishVersion(tree, root, replaced);
+    return deleted;
+}
+
+// Возвращает корень версии, которая не изменится и не будет освобождена до VREAD_END.
+const struct VNode* VREAD_BEGIN(const struct VersionedTree* tree, int* slot) {
+    for (int i = 0; i < VTREE_MAX_READERS; ++i) {
+        uint64_t free = 0;
+        if (tree->readerEpochs[i].compare_exchange_strong(free, tree->epoch.load())) {
+            *slot = i;
+            return tree->root.load();
+        }
+    }
+    throw std::runtime_error("Too many concurrent readers.");
+}
+
+void VREAD_END(const struct VersionedTree* tree, int slot) {
+    tree->readerEpochs[slot].store(0);
+}
+
+bool VIS_MEMBER(const struct VersionedTree* tree, const std::string& value) {
+    struct VTreeReadGuard read(tree);
+    const struct VNode* node = read.root;
+    while (node != nullptr && node->data != value) {
+        PROFILE_COUNT(nodesVisited, 1);
+        node = value < node->data ? node->left : node->right;
+    }
+    return node != nullptr;
+}
+
+int64_t VLENGTH(const struct VersionedTree* tree) {
+    struct VTreeReadGuard read(tree);
+    return getVSize(read.root);
+}
+
+void VRANGE(const struct VersionedTree* tree, const std::string& from, const std::string& to, struct OutputBuffer* out) {
+    struct VTreeReadGuard read(tree);
+    const struct VNode* current = read.root;
+    std::vector<const struct VNode*> path;
+    std::vector<const std::string*> values;
+    while (current != nullptr) {
+        if (current->data < from) {
+            current = current->right;
+        } else {
+            path.push_back(current);
+            current = current->left;
+        }
+    }
+    while (!path.empty() && !(to < path.back()->data)) {
+        current = path.back();
+        path.pop_back();
+        values.push_back(&current->data);
+        for (current = current->right; current != nullptr; current = current->left) path.push_back(current);
+    }
+    replyArrayBegin(out, values.size());
+    for (const std::string* value : values) replyArrayItem(out, *value);
+    replyArrayEnd(out);
+}
+
+void VPRINT(const struct VersionedTree* tree, struct OutputBuffer* out) {
+    VPRINT_PAGE(tree, 0, std::numeric_limits<int64_t>::max(), out);
+}
+
+void VPRINT_PAGE(const struct VersionedTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out) {
+    if (offset < 0 || limit < 0) throw std::out_of_range("Invalid page.");
+    struct VTreeReadGuard read(tree);
+    printTreePage(read.root, getVSize(read.root), offset, limit, out);
+}
@@ -5,12 +5,54 @@
 #include <string>
 #include <algorithm>
 #include <cmath>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "Output.h"
 
 #define MAX_NAME_LENGTH 32
 #define MAX_STRUCTURES 100
+#define BTREE_ORDER 32
+#define BTREE_MIN_KEYS (BTREE_ORDER / 2)
+#define HSET_GROUP_WIDTH 16
+#define HSET_MIGRATE_STEP 64
+#define HSET_EMPTY (-128)
+#define HSET_DELETED (-2)
+#define PQUEUE_ARITY 4
+#define TNODE_BLOCK 256
+#define LNODE_CAPACITY 16
+#define ARRAY_MIN_CAPACITY 4
+// Массивы от ARRAY_MMAP_THRESHOLD байт хранятся в анонимном mmap с прозрачными huge pages
+// и растут на месте через mremap; -DARRAY_MMAP_THRESHOLD=0 оставляет их в куче.
+#ifndef ARRAY_MMAP_THRESHOLD
+#define ARRAY_MMAP_THRESHOLD (64LL << 20)
+#endif
+#define ARRAY_MMAP_RESERVE 4
+#define ARRAY_HUGE_PAGE (2UL << 20)
+#define VTREE_MAX_READERS 64
+
+// Счётчики операций структуры. Увеличиваются только в сборке с -DSTORE_PROFILE: команда
+// выставляет activeCounters на счётчики своей структуры, а операции пишут туда через PROFILE_COUNT.
+struct OpCounters {
+    uint64_t operations;
+    uint64_t comparisons;
+    uint64_t nodesVisited;
+    uint64_t rotations;
+    uint64_t resizes;
+    uint64_t bytesCopied;
+};
+
+extern thread_local struct OpCounters* activeCounters;
+
+#ifdef STORE_PROFILE
+#define PROFILE_COUNT(field, amount) do { if (activeCounters) activeCounters->field += (amount); } while (0)
+#else
+#define PROFILE_COUNT(field, amount) ((void)0)
+#endif
 
 enum StructureType {
-    NONE_TYPE, ARRAY_TYPE, FLIST_TYPE, LLIST_TYPE, STACK_TYPE, QUEUE_TYPE, TREE_TYPE
+    NONE_TYPE, ARRAY_TYPE, FLIST_TYPE, LLIST_TYPE, STACK_TYPE, QUEUE_TYPE, TREE_TYPE, BTREE_TYPE, HSET_TYPE, PQUEUE_TYPE, VTREE_TYPE
 };
 
 struct FNode {
@@ -18,69 +60,189 @@ struct FNode {
     struct FNode* next;
 };
 
+// Узел развёрнутого списка: значения лежат подряд в values[0, count), остальные ячейки пусты.
+// Полный узел при вставке делится пополам, узел меньше чем наполовину заполненный при удалении
+// сливается с соседом, если их значения помещаются в один узел.
 struct LNode {
-    std::string data;
     struct LNode* next;
     struct LNode* prev;
+    int count;
+    std::string values[LNODE_CAPACITY];
 };
 
-struct TNode {
-    std::string data;
-    int height;
+// Узел АВЛ-дерева занимает ровно одну строку кэша. prefix - первые 8 байт ключа
+// (big-endian, дополненные нулями): сравнение идёт сначала по нему, и до символов
+// длинного ключа в куче доходит только при совпадении префиксов.
+struct alignas(64) TNode {
     struct TNode* left;
     struct TNode* right;
+    uint64_t prefix;
+    uint64_t size : 56;
+    uint64_t height : 8;
+    std::string data;
 };
 
+// Узлы дерева берутся из блоков по TNODE_BLOCK штук; освобождённые уходят в список freeList
+// (через left) и переиспользуются. Блоки отдаются, когда дерево опустеет.
+struct TNodePool {
+    std::vector<struct TNode*> blocks;
+    struct TNode* freeList;
+    int unused;
+};
+
+// Узел персистентного АВЛ-дерева. После публикации корня узел не меняется: запись копирует
+// путь от корня до места изменения, остальные поддеревья у старой и новой версий общие.
+struct VNode {
+    std::string data;
+    int height;
+    int64_t size;
+    const struct VNode* left;
+    const struct VNode* right;
+};
+
+// Узел B+-дерева: ключи лежат подряд, в листьях - сами значения, во внутренних узлах -
+// разделители (в children[i + 1] все ключи >= keys[i]). Один лишний слот нужен на время
+// вставки перед расщеплением.
+struct BNode {
+    bool isLeaf;
+    int count;
+    std::string keys[BTREE_ORDER + 1];
+    struct BNode** children;
+    struct BNode* next;
+};
+
+// Таблица с открытой адресацией в стиле SwissTable: у каждого слота есть байт метаданных -
+// HSET_EMPTY, HSET_DELETED или младшие 7 бит хеша. Слоты сгруппированы по 16, и группа
+// проверяется целиком одним сравнением SSE2.
+struct HashTable {
+    signed char* control;
+    std::string* slots;
+    int64_t capacity;
+    int64_t used;
+    int64_t deleted;
+};
+
+// elements - сырая память на capacity строк, сконструированы только первые size.
+// reserved - ёмкость, заказанная MRESERVE, ниже неё массив не сжимается.
+// mappedBytes - размер mmap-отображения под elements (0 - обычная куча, см. ARRAY_MMAP_THRESHOLD).
+// sorted - элементы упорядочены по возрастанию (ставит MSORT); пока флаг стоит, поиск двоичный.
+// Запись, нарушающая порядок, флаг снимает.
 struct DynamicArray {
     std::string* elements;
-    int size;
-    int capacity;
+    int64_t size;
+    int64_t capacity;
+    int64_t reserved;
+    size_t mappedBytes;
+    bool sorted;
 };
 
+// chunks - начала кусков для параллельного поиска (первый кусок всегда начинается с head).
+// Вставки их не портят, удаление узла сбрасывает; список пересобирается, когда длина удвоилась
+// с последней сборки (chunkedLength).
 struct SinglyLinkedList {
     struct FNode* head;
     struct FNode* tail;
-    int length;
+    int64_t length;
+    std::vector<struct FNode*> chunks;
+    int64_t chunkedLength;
 };
 
 struct DoublyLinkedList {
     struct LNode* head;
     struct LNode* tail;
-    int length;
+    int64_t length;
+    std::vector<struct LNode*> chunks;
+    int64_t chunkedLength;
 };
 
+// Вершина стека - последний элемент массива, поэтому снимок пишется снизу вверх прямым проходом.
 struct Stack {
-    struct FNode* top;
-    int count;
+    struct DynamicArray items;
 };
 
 struct Queue {
     struct FNode* front;
     struct FNode* rear;
-    int count;
+    int64_t count;
 };
 
 struct AVLTree {
     struct TNode* root;
+    int64_t count;
+    struct TNodePool pool;
+};
+
+struct BPlusTree {
+    struct BNode* root;
+    struct BNode* firstLeaf;
+    int64_t count;
+};
+
+// При расширении таблица не перестраивается сразу: прежняя остаётся в old, и каждая
+// изменяющая операция переносит из неё HSET_MIGRATE_STEP слотов (old.capacity == 0 - переноса нет).
+struct HashSet {
+    struct HashTable current;
+    struct HashTable old;
+    int64_t migrated;
+    int64_t count;
+};
+
+struct RetiredNodes {
+    uint64_t epoch;
+    std::vector<const struct VNode*> nodes;
 };
 
+// Читатели берут корень без блокировок и объявляют эпоху в readerEpochs (0 - слот свободен).
+// Узлы, вытесненные записью в эпоху e, удаляются, когда у всех активных читателей эпоха больше e.
+// Писатели упорядочены writerLock.
+struct VersionedTree {
+    std::atomic<const struct VNode*> root;
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<uint64_t> readerEpochs[VTREE_MAX_READERS];
+    std::mutex writerLock;
+    std::vector<struct RetiredNodes> retired;
+};
+
+// Минимальная d-арная куча (d = PQUEUE_ARITY) поверх динамического массива: потомки
+// элемента i лежат в [d * i + 1, d * i + d], наименьший элемент - elements[0].
+struct PriorityQueue {
+    struct DynamicArray heap;
+};
+
+// Операции вставки принимают значение и по const&, и по &&: rvalue-перегрузка забирает строку
+// без копии, const& копирует её ровно один раз. Извлекающие операции (DEL/POP) перемещают значение из узла.
 void MCREATE(struct DynamicArray* array);
 void MDESTROY(struct DynamicArray* array);
+void MGROW(struct DynamicArray* array, int64_t capacity);
+void MRESERVE(struct DynamicArray* array, int64_t capacity);
 void MPUSH_BACK(struct DynamicArray* array, const std::string& value);
-void MINSERT_AT(struct DynamicArray* array, int index, const std::string& value);
-void MSET_AT(struct DynamicArray* array, int index, const std::string& value);
-std::string MDEL_AT(struct DynamicArray* array, int index);
-std::string MGET(const struct DynamicArray* array, int index);
+void MPUSH_BACK(struct DynamicArray* array, std::string&& value);
+void MINSERT_AT(struct DynamicArray* array, int64_t index, const std::string& value);
+void MINSERT_AT(struct DynamicArray* array, int64_t index, std::string&& value);
+void MSET_AT(struct DynamicArray* array, int64_t index, const std::string& value);
+void MSET_AT(struct DynamicArray* array, int64_t index, std::string&& value);
+std::string MDEL_AT(struct DynamicArray* array, int64_t index);
+std::string MGET(const struct DynamicArray* array, int64_t index);
+void MSORT(struct DynamicArray* array);
+int64_t MLOWER_BOUND(const struct DynamicArray* array, const std::string& value);
 bool MIS_MEMBER(const struct DynamicArray* array, const std::string& value);
-int MLENGTH(const struct DynamicArray* array);
-void MPRINT(const struct DynamicArray* array);
+int64_t MCOUNT(const struct DynamicArray* array, const std::string& value);
+std::vector<int64_t> MFIND_ALL(const struct DynamicArray* array, const std::string& value);
+int64_t MLENGTH(const struct DynamicArray* array);
+void MPRINT(const struct DynamicArray* array, struct OutputBuffer* out);
+void MPRINT_RANGE(const struct DynamicArray* array, int64_t from, int64_t to, struct OutputBuffer* out);
+void MPRINT_PAGE(const struct DynamicArray* array, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 void FCREATE(struct SinglyLinkedList* list);
 void FDESTROY(struct SinglyLinkedList* list);
 void FPUSH_HEAD(struct SinglyLinkedList* list, const std::string& value);
+void FPUSH_HEAD(struct SinglyLinkedList* list, std::string&& value);
 void FPUSH_TAIL(struct SinglyLinkedList* list, const std::string& value);
+void FPUSH_TAIL(struct SinglyLinkedList* list, std::string&& value);
 bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeValue, const std::string& newValue);
+bool FINS_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& beforeValue, std::string&& newValue);
 bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterValue, const std::string& newValue);
+bool FINS_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& afterValue, std::string&& newValue);
 std::string FDEL_HEAD(struct SinglyLinkedList* list);
 std::string FDEL_TAIL(struct SinglyLinkedList* list);
 bool FDEL_BY_VALUE(struct SinglyLinkedList* list, const std::string& value);
@@ -88,16 +250,23 @@ bool FDEL_BEFORE_VALUE(struct SinglyLinkedList* list, const std::string& value);
 bool FDEL_AFTER_VALUE(struct SinglyLinkedList* list, const std::string& value);
 std::string FGET_HEAD(const struct SinglyLinkedList* list);
 std::string FGET_TAIL(const struct SinglyLinkedList* list);
-std::string FGET_AT(const struct SinglyLinkedList* list, int index);
-bool FIS_MEMBER(const struct SinglyLinkedList* list, const std::string& value);
-void FPRINT(const struct SinglyLinkedList* list);
+std::string FGET_AT(const struct SinglyLinkedList* list, int64_t index);
+bool FIS_MEMBER(struct SinglyLinkedList* list, const std::string& value);
+int64_t FCOUNT(struct SinglyLinkedList* list, const std::string& value);
+std::vector<int64_t> FFIND_ALL(struct SinglyLinkedList* list, const std::string& value);
+void FPRINT(const struct SinglyLinkedList* list, struct OutputBuffer* out);
+void FPRINT_PAGE(const struct SinglyLinkedList* list, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 void LCREATE(struct DoublyLinkedList* list);
 void LDESTROY(struct DoublyLinkedList* list);
 void LPUSH_HEAD(struct DoublyLinkedList* list, const std::string& value);
+void LPUSH_HEAD(struct DoublyLinkedList* list, std::string&& value);
 void LPUSH_TAIL(struct DoublyLinkedList* list, const std::string& value);
+void LPUSH_TAIL(struct DoublyLinkedList* list, std::string&& value);
 bool LINS_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& beforeValue, const std::string& newValue);
+bool LINS_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& beforeValue, std::string&& newValue);
 bool LINS_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& afterValue, const std::string& newValue);
+bool LINS_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& afterValue, std::string&& newValue);
 std::string LDEL_HEAD(struct DoublyLinkedList* list);
 std::string LDEL_TAIL(struct DoublyLinkedList* list);
 bool LDEL_BY_VALUE(struct DoublyLinkedList* list, const std::string& value);
@@ -105,31 +274,109 @@ bool LDEL_BEFORE_VALUE(struct DoublyLinkedList* list, const std::string& value);
 bool LDEL_AFTER_VALUE(struct DoublyLinkedList* list, const std::string& value);
 std::string LGET_HEAD(const struct DoublyLinkedList* list);
 std::string LGET_TAIL(const struct DoublyLinkedList* list);
-std::string LGET_AT(const struct DoublyLinkedList* list, int index);
-bool LIS_MEMBER(const struct DoublyLinkedList* list, const std::string& value);
-void LPRINT(const struct DoublyLinkedList* list);
+std::string LGET_AT(const struct DoublyLinkedList* list, int64_t index);
+bool LIS_MEMBER(struct DoublyLinkedList* list, const std::string& value);
+int64_t LCOUNT(struct DoublyLinkedList* list, const std::string& value);
+std::vector<int64_t> LFIND_ALL(struct DoublyLinkedList* list, const std::string& value);
+void LPRINT(const struct DoublyLinkedList* list, struct OutputBuffer* out);
+void LPRINT_PAGE(const struct DoublyLinkedList* list, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 void SCREATE(struct Stack* stack);
 void SDESTROY(struct Stack* stack);
 void SPUSH(struct Stack* stack, const std::string& value);
+void SPUSH(struct Stack* stack, std::string&& value);
 std::string SPOP(struct Stack* stack);
 std::string SPEEK(const struct Stack* stack);
-int SLENGTH(const struct Stack* stack);
-void SPRINT(const struct Stack* stack);
+int64_t SLENGTH(const struct Stack* stack);
+void SPRINT(const struct Stack* stack, struct OutputBuffer* out);
+void SPRINT_PAGE(const struct Stack* stack, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 void QCREATE(struct Queue* queue);
 void QDESTROY(struct Queue* queue);
 void QPUSH(struct Queue* queue, const std::string& value);
+void QPUSH(struct Queue* queue, std::string&& value);
 std::string QPOP(struct Queue* queue);
 std::string QPEEK(const struct Queue* queue);
-int QLENGTH(const struct Queue* queue);
-void QPRINT(const struct Queue* queue);
+int64_t QLENGTH(const struct Queue* queue);
+void QPRINT(const struct Queue* queue, struct OutputBuffer* out);
+void QPRINT_PAGE(const struct Queue* queue, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 void TCREATE(struct AVLTree* tree);
 void TDESTROY(struct AVLTree* tree);
 void TINSERT(struct AVLTree* tree, const std::string& value);
+void TINSERT(struct AVLTree* tree, std::string&& value);
 bool TDEL(struct AVLTree* tree, const std::string& value);
 bool TIS_MEMBER(const struct AVLTree* tree, const std::string& value);
-void TPRINT(const struct AVLTree* tree);
+int64_t TLENGTH(const struct AVLTree* tree);
+void TPRINT(const struct AVLTree* tree, struct OutputBuffer* out);
+void TPRINT_PAGE(const struct AVLTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out);
+// Заменяют содержимое dst объединением, пересечением или разностью a и b; dst может быть a или b.
+void TUNION(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b);
+void TINTERSECT(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b);
+void TDIFF(struct AVLTree* dst, const struct AVLTree* a, const struct AVLTree* b);
+// Строит пустое дерево из строго возрастающих values за один проход; false - порядок нарушен
+// или дерево не пусто, тогда ничего не меняется.
+bool TLOAD_SORTED(struct AVLTree* tree, const std::vector<std::string_view>& values);
+
+void BCREATE(struct BPlusTree* tree);
+void BDESTROY(struct BPlusTree* tree);
+bool BINSERT(struct BPlusTree* tree, const std::string& value);
+bool BINSERT(struct BPlusTree* tree, std::string&& value);
+bool BDEL(struct BPlusTree* tree, const std::string& value);
+bool BIS_MEMBER(const struct BPlusTree* tree, const std::string& value);
+int64_t BLENGTH(const struct BPlusTree* tree);
+void BRANGE(const struct BPlusTree* tree, const std::string& from, const std::string& to, struct OutputBuffer* out);
+void BPRINT(const struct BPlusTree* tree, struct OutputBuffer* out);
+void BPRINT_PAGE(const struct BPlusTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out);
+
+void HCREATE(struct HashSet* set);
+void HDESTROY(struct HashSet* set);
+void HRESERVE(struct HashSet* set, int64_t count);
+bool HADD(struct HashSet* set, const std::string& value);
+bool HADD(struct HashSet* set, std::string&& value);
+bool HDEL(struct HashSet* set, const std::string& value);
+bool HIS_MEMBER(const struct HashSet* set, const std::string& value);
+int64_t HLENGTH(const struct HashSet* set);
+void HPRINT(const struct HashSet* set, struct OutputBuffer* out);
+void HPRINT_PAGE(const struct HashSet* set, int64_t offset, int64_t limit, struct OutputBuffer* out);
+
+void PCREATE(struct PriorityQueue* queue);
+void PDESTROY(struct PriorityQueue* queue);
+void PPUSH(struct PriorityQueue* queue, const std::string& value);
+void PPUSH(struct PriorityQueue* queue, std::string&& value);
+void PAPPEND(struct PriorityQueue* queue, const std::string& value);
+void PAPPEND(struct PriorityQueue* queue, std::string&& value);
+void PHEAPIFY(struct PriorityQueue* queue);
+std::string PPOP(struct PriorityQueue* queue);
+std::string PPEEK(const struct PriorityQueue* queue);
+int64_t PLENGTH(const struct PriorityQueue* queue);
+void PTOPK(const struct PriorityQueue* queue, int64_t k, struct OutputBuffer* out);
+void PPRINT(const struct PriorityQueue* queue, struct OutputBuffer* out);
+void PPRINT_PAGE(const struct PriorityQueue* queue, int64_t offset, int64_t limit, struct OutputBuffer* out);
+
+void VCREATE(struct VersionedTree* tree);
+void VDESTROY(struct VersionedTree* tree);
+bool VINSERT(struct VersionedTree* tree, const std::string& value);
+bool VINSERT(struct VersionedTree* tree, std::string&& value);
+bool VLOAD_SORTED(struct VersionedTree* tree, const std::vector<std::string_view>& values);
+bool VDEL(struct VersionedTree* tree, const std::string& value);
+const struct VNode* VREAD_BEGIN(const struct VersionedTree* tree, int* slot);
+void VREAD_END(const struct VersionedTree* tree, int slot);
+// Слот читателя на время жизни объекта: VREAD_END вызывается и при исключении, иначе занятый
+// слот навсегда остановил бы освобождение вытесненных узлов.
+struct VTreeReadGuard {
+    const struct VersionedTree* tree;
+    int slot;
+    const struct VNode* root;
+    explicit VTreeReadGuard(const struct VersionedTree* readTree) : tree(readTree), slot(0), root(VREAD_BEGIN(readTree, &slot)) {}
+    ~VTreeReadGuard() { VREAD_END(tree, slot); }
+    VTreeReadGuard(const VTreeReadGuard&) = delete;
+    VTreeReadGuard& operator=(const VTreeReadGuard&) = delete;
+};
+bool VIS_MEMBER(const struct VersionedTree* tree, const std::string& value);
+int64_t VLENGTH(const struct VersionedTree* tree);
+void VRANGE(const struct VersionedTree* tree, const std::string& from, const std::string& to, struct OutputBuffer* out);
+void VPRINT(const struct VersionedTree* tree, struct OutputBuffer* out);
+void VPRINT_PAGE(const struct VersionedTree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "Output.h"
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+static void writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+}
+
+static void reserveOutput(struct OutputBuffer* out, size_t extra) {
+    if (out->length + extra <= out->capacity) return;
+    size_t newCapacity = out->capacity * 2;
+    while (newCapacity < out->length + extra) newCapacity *= 2;
+    char* newData = new char[newCapacity];
+    memcpy(newData, out->data, out->length);
+    delete[] out->data;
+    out->data = newData;
+    out->capacity = newCapacity;
+}
+
+void initOutput(struct OutputBuffer* out, int fd, enum OutputFormat format) {
+    out->fd = fd;
+    out->errorFd = STDERR_FILENO;
+    out->format = format;
+    out->capacity = OUTPUT_BUFFER_CAPACITY;
+    out->data = new char[out->capacity];
+    out->length = 0;
+    out->flushThreshold = OUTPUT_FLUSH_THRESHOLD;
+    out->arrayItems = 0;
+    out->capture = nullptr;
+    out->captureFrom = 0;
+    out->captureLimit = 0;
+}
+
+void destroyOutput(struct OutputBuffer* out) {
+    flushOutput(out);
+    delete[] out->data;
+    out->data = nullptr;
+    out->length = 0;
+    out->capacity = 0;
+}
+
+static void appendCapture(struct OutputBuffer* out, const char* data, size_t length) {
+    if (!out->capture) return;
+    if (out->capture->size() + length > out->captureLimit) out->capture = nullptr;
+    else out->capture->append(data, length);
+}
+
+void flushOutput(struct OutputBuffer* out) {
+    if (out->fd < 0 || out->length == 0) return;
+    appendCapture(out, out->data + out->captureFrom, out->length - out->captureFrom);
+    out->captureFrom = 0;
+    writeAll(out->fd, out->data, out->length);
+    out->length = 0;
+}
+
+void beginCapture(struct OutputBuffer* out, std::string* target, size_t limit) {
+    out->capture = target;
+    out->captureFrom = out->length;
+    out->captureLimit = limit;
+}
+
+bool endCapture(struct OutputBuffer* out) {
+    appendCapture(out, out->data + out->captureFrom, out->length - out->captureFrom);
+    bool complete = out->capture != nullptr;
+    out->capture = nullptr;
+    out->captureFrom = 0;
+    return complete;
+}
+
+void writeRaw(struct OutputBuffer* out, const char* data, size_t length) {
+    if (out->fd >= 0 && out->length + length > out->capacity) {
+        flushOutput(out);
+        if (length >= out->capacity) {
+            appendCapture(out, data, length);
+            writeAll(out->fd, data, length);
+            return;
+        }
+    }
+    reserveOutput(out, length);
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    if (out->fd >= 0 && out->length >= out->flushThreshold) flushOutput(out);
+}
+
+void writeRaw(struct OutputBuffer* out, std::string_view data) {
+    writeRaw(out, data.data(), data.size());
+}
+
+static void writeChar(struct OutputBuffer* out, char c) {
+    writeRaw(out, &c, 1);
+}
+
+static bool isResp(const struct OutputBuffer* out) {
+    return out->format == RESP2_FORMAT || out->format == RESP3_FORMAT;
+}
+
+static void writeRespHeader(struct OutputBuffer* out, char prefix, long long value) {
+    writeChar(out, prefix);
+    writeRaw(out, std::to_string(value));
+    writeRaw(out, "\r\n", 2);
+}
+
+// Ответ COMPACT - ровно одна строка: перевод строки и обратный слэш внутри значения экранируются.
+static void writeCompactValue(struct OutputBuffer* out, std::string_view value) {
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] != '\n' && value[i] != '\\') continue;
+        writeRaw(out, value.data() + start, i - start);
+        writeRaw(out, value[i] == '\n' ? "\\n" : "\\\\", 2);
+        start = i + 1;
+    }
+    writeRaw(out, value.data() + start, value.size() - start);
+}
+
+static const char* errorCodeName(enum ErrorCode code) {
+    switch (code) {
+        case ERR_SYNTAX: return "SYNTAX";
+        case ERR_UNKNOWN_COMMAND: return "UNKNOWN";
+        case ERR_NO_SUCH_STRUCTURE: return "NOSTRUCT";
+        case ERR_WRONG_TYPE: return "WRONGTYPE";
+        case ERR_OUT_OF_RANGE: return "RANGE";
+        case ERR_EMPTY: return "EMPTY";
+        case ERR_READ_ONLY: return "READONLY";
+        default: return "ERR";
+    }
+}
+
+void replyOK(struct OutputBuffer* out) {
+    if (isResp(out)) {
+        writeRaw(out, "+OK\r\n", 5);
+        return;
+    }
+    writeRaw(out, out->format == TEXT_FORMAT ? "OK\n" : "+OK\n", out->format == TEXT_FORMAT ? 3 : 4);
+}
+
+void replyValue(struct OutputBuffer* out, std::string_view value) {
+    if (isResp(out)) {
+        writeRespHeader(out, '$', static_cast<long long>(value.size()));
+        writeRaw(out, value);
+        writeRaw(out, "\r\n", 2);
+        return;
+    }
+    if (out->format == COMPACT_FORMAT) {
+        writeChar(out, '=');
+        writeCompactValue(out, value);
+    } else {
+        writeRaw(out, value);
+    }
+    writeChar(out, '\n');
+}
+
+void replyInteger(struct OutputBuffer* out, long long value) {
+    if (isResp(out)) {
+        writeRespHeader(out, ':', value);
+        return;
+    }
+    if (out->format == COMPACT_FORMAT) writeChar(out, ':');
+    writeRaw(out, std::to_string(value));
+    writeChar(out, '\n');
+}
+
+void replyBool(struct OutputBuffer* out, bool value) {
+    if (out->format == TEXT_FORMAT) writeRaw(out, value ? "TRUE\n" : "FALSE\n", value ? 5 : 6);
+    else if (out->format == COMPACT_FORMAT) writeRaw(out, value ? "#T\n" : "#F\n", 3);
+    else if (out->format == RESP3_FORMAT) writeRaw(out, value ? "#t\r\n" : "#f\r\n", 4);
+    else writeRaw(out, value ? ":1\r\n" : ":0\r\n", 4);
+}
+
+void replyNotFound(struct OutputBuffer* out) {
+    if (out->format == TEXT_FORMAT) writeRaw(out, "Not Found\n", 10);
+    else if (out->format == COMPACT_FORMAT) writeRaw(out, "_\n", 2);
+    else if (out->format == RESP3_FORMAT) writeRaw(out, "_\r\n", 3);
+    else writeRaw(out, "$-1\r\n", 5);
+}
+
+void replyError(struct OutputBuffer* out, enum ErrorCode code, const std::string& message) {
+    if (out->format == TEXT_FORMAT) {
+        // Ошибки в текстовом режиме идут в stderr; сначала сбрасываем stdout, чтобы сохранить порядок.
+        flushOutput(out);
+        std::string line = "ERROR: " + message + "\n";
+        writeAll(out->errorFd, line.data(), line.size());
+        return;
+    }
+    if (isResp(out)) {
+        std::string line = message;
+        std::replace(line.begin(), line.end(), '\r', ' ');
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        writeChar(out, '-');
+        writeRaw(out, errorCodeName(code), strlen(errorCodeName(code)));
+        writeChar(out, ' ');
+        writeRaw(out, line);
+        writeRaw(out, "\r\n", 2);
+        return;
+    }
+    writeChar(out, '-');
+    writeRaw(out, std::to_string(static_cast<int>(code)));
+    writeChar(out, ' ');
+    writeCompactValue(out, message);
+    writeChar(out, '\n');
+}
+
+void replyArrayBegin(struct OutputBuffer* out, size_t count) {
+    out->arrayItems = 0;
+    if (isResp(out)) {
+        writeRespHeader(out, '*', static_cast<long long>(count));
+    } else if (out->format == COMPACT_FORMAT) {
+        writeChar(out, '*');
+        writeRaw(out, std::to_string(count));
+        writeChar(out, '\n');
+    }
+}
+
+void replyArrayItem(struct OutputBuffer* out, std::string_view value) {
+    if (out->format == TEXT_FORMAT) {
+        if (out->arrayItems > 0) writeChar(out, ' ');
+        writeRaw(out, value);
+    } else {
+        replyValue(out, value);
+    }
+    out->arrayItems++;
+}
+
+void replyArrayEnd(struct OutputBuffer* out) {
+    if (out->format == TEXT_FORMAT) writeChar(out, '\n');
+}
+
+void replyMapBegin(struct OutputBuffer* out, size_t pairs) {
+    if (out->format == RESP3_FORMAT) writeRespHeader(out, '%', static_cast<long long>(pairs));
+    else replyArrayBegin(out, pairs * 2);
+}
@@ -0,0 +1,71 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <stdexcept>
+
+#define OUTPUT_BUFFER_CAPACITY 65536
+#define OUTPUT_FLUSH_THRESHOLD 49152
+
+// TEXT_FORMAT - привычный вывод REPL; COMPACT_FORMAT - по одной строке с префиксом на ответ,
+// коды ошибок передаются в том же потоке:
+//   +OK   =value   :integer   #T/#F   _ (не найдено)   *count   -code message
+// В value и message перевод строки пишется как \n, обратный слэш - как \\, так что граница
+// ответа - всегда '\n', а значение восстанавливается обратной заменой.
+// RESP2_FORMAT/RESP3_FORMAT - ответы протокола Redis для сетевого режима.
+enum OutputFormat {
+    TEXT_FORMAT, COMPACT_FORMAT, RESP2_FORMAT, RESP3_FORMAT
+};
+
+enum ErrorCode {
+    ERR_NONE, ERR_SYNTAX, ERR_UNKNOWN_COMMAND, ERR_NO_SUCH_STRUCTURE, ERR_WRONG_TYPE,
+    ERR_OUT_OF_RANGE, ERR_EMPTY, ERR_FAILED, ERR_READ_ONLY
+};
+
+struct CommandError : public std::runtime_error {
+    enum ErrorCode code;
+    CommandError(enum ErrorCode errorCode, const std::string& message)
+        : std::runtime_error(message), code(errorCode) {}
+};
+
+// fd < 0: вывод копится в памяти, пока вызывающий код сам не заберёт байты.
+// capture, если задан, получает копию всего, что пишется в буфер начиная с data[captureFrom]
+// (так строится кэш PRINT). Копия дописывается кусками при сбросе буфера; когда она переросла бы
+// captureLimit, capture сбрасывается в nullptr.
+struct OutputBuffer {
+    int fd;
+    int errorFd;
+    enum OutputFormat format;
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t flushThreshold;
+    size_t arrayItems;
+    std::string* capture;
+    size_t captureFrom;
+    size_t captureLimit;
+};
+
+void initOutput(struct OutputBuffer* out, int fd, enum OutputFormat format);
+void destroyOutput(struct OutputBuffer* out);
+void flushOutput(struct OutputBuffer* out);
+void writeRaw(struct OutputBuffer* out, const char* data, size_t length);
+void writeRaw(struct OutputBuffer* out, std::string_view data);
+void beginCapture(struct OutputBuffer* out, std::string* target, size_t limit);
+// Дописывает остаток копии; false - копия не уложилась в лимит и неполна.
+bool endCapture(struct OutputBuffer* out);
+
+void replyOK(struct OutputBuffer* out);
+void replyValue(struct OutputBuffer* out, std::string_view value);
+void replyInteger(struct OutputBuffer* out, long long value);
+void replyBool(struct OutputBuffer* out, bool value);
+void replyNotFound(struct OutputBuffer* out);
+void replyError(struct OutputBuffer* out, enum ErrorCode code, const std::string& message);
+void replyArrayBegin(struct OutputBuffer* out, size_t count);
+void replyArrayItem(struct OutputBuffer* out, std::string_view value);
+void replyArrayEnd(struct OutputBuffer* out);
+void replyMapBegin(struct OutputBuffer* out, size_t pairs);
+
+#endif
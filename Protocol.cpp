@@ -0,0 +1,95 @@
+#include "Protocol.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#define RESP_MAX_LENGTH_LINE 24
+
+static enum ParseResult parseLength(const char* data, size_t length, size_t* position, char prefix, long long limit, long long* value) {
+    if (*position >= length) return PARSE_INCOMPLETE;
+    if (data[*position] != prefix) return PARSE_ERROR;
+    // Строка длины - префикс, знак и не больше 20 цифр; без \r дальше ждать незачем.
+    size_t available = std::min<size_t>(length - *position, RESP_MAX_LENGTH_LINE);
+    const char* lineEnd = static_cast<const char*>(memchr(data + *position, '\r', available));
+    if (lineEnd == nullptr) return available < RESP_MAX_LENGTH_LINE ? PARSE_INCOMPLETE : PARSE_ERROR;
+    size_t end = static_cast<size_t>(lineEnd - data);
+    if (end + 1 >= length) return PARSE_INCOMPLETE;
+    if (data[end + 1] != '\n') return PARSE_ERROR;
+
+    long long result = 0;
+    bool negative = false;
+    size_t i = *position + 1;
+    if (i < end && data[i] == '-') { negative = true; ++i; }
+    if (i == end) return PARSE_ERROR;
+    for (; i < end; ++i) {
+        if (data[i] < '0' || data[i] > '9') return PARSE_ERROR;
+        result = result * 10 + (data[i] - '0');
+        if (result > limit) return PARSE_ERROR;
+    }
+    *value = negative ? -result : result;
+    *position = end + 2;
+    return PARSE_OK;
+}
+
+static enum ParseResult parseInline(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens) {
+    const char* lineEnd = static_cast<const char*>(memchr(data, '\n', std::min<size_t>(length, RESP_MAX_INLINE_LENGTH)));
+    if (lineEnd == nullptr) return length < RESP_MAX_INLINE_LENGTH ? PARSE_INCOMPLETE : PARSE_ERROR;
+    size_t end = static_cast<size_t>(lineEnd - data);
+    std::stringstream lineStream(std::string(data, end));
+    std::string token;
+    tokens->clear();
+    while (lineStream >> token) tokens->push_back(token);
+    *consumed = end + 1;
+    return PARSE_OK;
+}
+
+void resetRequestState(struct RequestState* state) {
+    state->count = -1;
+    state->position = 0;
+    state->bytes = 0;
+}
+
+static enum ParseResult parseArray(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens, struct RequestState* state) {
+    enum ParseResult result;
+    if (state->count < 0) {
+        size_t position = 0;
+        long long count = 0;
+        result = parseLength(data, length, &position, '*', RESP_MAX_ARGUMENTS, &count);
+        if (result != PARSE_OK) return result;
+        if (count < 0) return PARSE_ERROR;
+        tokens->clear();
+        // Длину массива присылает клиент: заранее берём не больше 1024 мест, дальше вектор растёт сам.
+        tokens->reserve(static_cast<size_t>(std::min<long long>(count, 1024)));
+        state->count = count;
+        state->position = position;
+    }
+    while (static_cast<long long>(tokens->size()) < state->count) {
+        size_t position = state->position;
+        long long bulkLength = 0;
+        result = parseLength(data, length, &position, '$', RESP_MAX_BULK_LENGTH, &bulkLength);
+        if (result != PARSE_OK) return result;
+        if (bulkLength < 0 || state->bytes + bulkLength > RESP_MAX_REQUEST_LENGTH) return PARSE_ERROR;
+        size_t size = static_cast<size_t>(bulkLength);
+        if (position + size + 2 > length) return PARSE_INCOMPLETE;
+        if (data[position + size] != '\r' || data[position + size + 1] != '\n') return PARSE_ERROR;
+        tokens->emplace_back(data + position, size);
+        state->position = position + size + 2;
+        state->bytes += bulkLength;
+    }
+    *consumed = state->position;
+    return PARSE_OK;
+}
+
+enum ParseResult parseRequest(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens, struct RequestState* state) {
+    if (length == 0) return PARSE_INCOMPLETE;
+    if (state->count < 0 && data[0] != '*') return parseInline(data, length, consumed, tokens);
+    enum ParseResult result = parseArray(data, length, consumed, tokens, state);
+    if (result != PARSE_INCOMPLETE) resetRequestState(state);
+    return result;
+}
+
+enum ParseResult parseRequest(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens) {
+    struct RequestState state;
+    resetRequestState(&state);
+    return parseRequest(data, length, consumed, tokens, &state);
+}
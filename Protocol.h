@@ -0,0 +1,36 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#define RESP_MAX_ARGUMENTS 1048576
+#define RESP_MAX_BULK_LENGTH (512 * 1024 * 1024)
+// Сумма длин аргументов одного запроса и длина inline-строки: больше не буферизуем.
+#define RESP_MAX_REQUEST_LENGTH (1024LL * 1024 * 1024)
+#define RESP_MAX_INLINE_LENGTH (64 * 1024)
+
+enum ParseResult {
+    PARSE_OK, PARSE_INCOMPLETE, PARSE_ERROR
+};
+
+// Разбор запроса, пришедшего не целиком: готовые аргументы остаются в tokens, а position -
+// смещение первого неразобранного байта от начала запроса. Следующий вызов с тем же началом
+// буфера продолжает с него, поэтому каждый аргумент разбирается и копируется один раз.
+struct RequestState {
+    long long count;
+    size_t position;
+    long long bytes;
+};
+
+void resetRequestState(struct RequestState* state);
+
+// Разбирает один запрос из начала буфера: массив RESP из bulk-строк (*N\r\n$len\r\n...)
+// или inline-команду, разделённую пробелами. При PARSE_OK в consumed - длина запроса.
+// С state разбор продолжается с места, где прошлый вызов вернул PARSE_INCOMPLETE;
+// после PARSE_OK и PARSE_ERROR state сброшен.
+enum ParseResult parseRequest(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens, struct RequestState* state);
+enum ParseResult parseRequest(const char* data, size_t length, size_t* consumed, std::vector<std::string>* tokens);
+
+#endif
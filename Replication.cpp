@@ -0,0 +1,193 @@
+#include "Replication.h"
+#include "Commands.h"
+#include "Protocol.h"
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define REPLICATION_READ_CHUNK 65536
+
+int64_t replicationClock() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void writeReplicationEntry(struct OutputBuffer* out, uint64_t offset, int64_t timestamp, const std::vector<std::string>* tokens) {
+    replyArrayBegin(out, 2 + (tokens ? tokens->size() : 0));
+    replyArrayItem(out, std::to_string(offset));
+    replyArrayItem(out, std::to_string(timestamp));
+    if (tokens) {
+        for (const std::string& token : *tokens) replyArrayItem(out, token);
+    }
+    replyArrayEnd(out);
+}
+
+bool readReplicationSnapshot(const struct DataStore* store, const std::string& filename, std::string* bytes) {
+    std::string tempName = filename + ".sync";
+    saveToFile(store, tempName);
+    std::ifstream file(tempName, std::ios::binary);
+    if (!file.is_open()) return false;
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    *bytes = contents.str();
+    unlink(tempName.c_str());
+    return true;
+}
+
+void closeReplicationLink(struct DataStore* store) {
+    struct ReplicationState* replication = &store->replication;
+    if (replication->leaderFd >= 0) close(replication->leaderFd);
+    replication->leaderFd = -1;
+    replication->input.clear();
+    replication->retryAt = replicationClock() + REPLICATION_RETRY_MS;
+}
+
+static int connectToLeader(const std::string& socketPath) {
+    struct sockaddr_un address;
+    if (socketPath.size() >= sizeof(address.sun_path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    // Загрузка снимка блокирует цикл сервера, поэтому ждём ведущего не дольше таймаута.
+    struct timeval timeout = {REPLICATION_SYNC_TIMEOUT_MS / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Ждёт ответ на SYNC целиком; байты потока, пришедшие следом, остаются в input.
+static bool receiveSyncReply(int fd, std::string* input, std::vector<std::string>* tokens) {
+    static const char request[] = "*1\r\n$4\r\nSYNC\r\n";
+    if (write(fd, request, sizeof(request) - 1) != static_cast<ssize_t>(sizeof(request) - 1)) return false;
+    char chunk[REPLICATION_READ_CHUNK];
+    while (true) {
+        size_t consumed = 0;
+        enum ParseResult result = parseRequest(input->data(), input->size(), &consumed, tokens);
+        if (result == PARSE_ERROR) return false;
+        if (result == PARSE_OK) {
+            input->erase(0, consumed);
+            break;
+        }
+        ssize_t received = read(fd, chunk, sizeof(chunk));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        input->append(chunk, static_cast<size_t>(received));
+    }
+    // Отказ ведущего приходит строкой ошибки, которая разбирается как inline-команда.
+    if (tokens->size() != 2 || tokens->at(0).empty() || tokens->at(0)[0] == '-') {
+        std::string message;
+        for (const std::string& token : *tokens) message += (message.empty() ? "" : " ") + token;
+        std::cerr << "ERROR: Leader refused SYNC: " << message << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool syncWithLeader(struct DataStore* store, const std::string& filename) {
+    struct ReplicationState* replication = &store->replication;
+    closeReplicationLink(store);
+    int fd = connectToLeader(replication->leaderPath);
+    if (fd < 0) return false;
+
+    std::string input;
+    std::vector<std::string> tokens;
+    uint64_t offset = 0;
+    try {
+        if (!receiveSyncReply(fd, &input, &tokens)) throw std::runtime_error("no reply");
+        offset = std::stoull(tokens[0]);
+    } catch (const std::exception&) {
+        close(fd);
+        return false;
+    }
+
+    // Снимок ведущего заменяет файл ведомого: дожидаемся BGSAVE, чтобы ребёнок не записал поверх.
+    pollBackgroundSave(store, filename, true);
+    std::string tempName = filename + ".sync";
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    file.write(tokens[1].data(), static_cast<std::streamsize>(tokens[1].size()));
+    file.close();
+    if (!file || rename(tempName.c_str(), filename.c_str()) != 0) {
+        std::cerr << "ERROR: Could not write leader snapshot to '" << filename << "'." << std::endl;
+        unlink(tempName.c_str());
+        close(fd);
+        return false;
+    }
+    loadFromFile(store, filename);
+    store->background.pendingChanges = 0;
+
+    replication->leaderFd = fd;
+    replication->input = std::move(input);
+    replication->offset = offset;
+    replication->leaderTime = replicationClock();
+    replication->lagMs = 0;
+    return true;
+}
+
+int applyReplicationStream(struct DataStore* store) {
+    struct ReplicationState* replication = &store->replication;
+    char chunk[REPLICATION_READ_CHUNK];
+    ssize_t received = read(replication->leaderFd, chunk, sizeof(chunk));
+    if (received < 0 && (errno == EINTR || errno == EAGAIN)) return 0;
+    if (received <= 0) {
+        closeReplicationLink(store);
+        return 0;
+    }
+    replication->input.append(chunk, static_cast<size_t>(received));
+
+    struct OutputBuffer discard;
+    initOutput(&discard, -1, RESP2_FORMAT);
+    std::vector<std::string> tokens;
+    int modified = 0;
+    size_t position = 0;
+    bool broken = false;
+    while (position < replication->input.size()) {
+        size_t consumed = 0;
+        enum ParseResult result = parseRequest(replication->input.data() + position, replication->input.size() - position, &consumed, &tokens);
+        if (result == PARSE_INCOMPLETE) break;
+        uint64_t offset = 0;
+        int64_t timestamp = 0;
+        try {
+            if (result == PARSE_ERROR || tokens.size() < 2) throw std::runtime_error("bad entry");
+            offset = std::stoull(tokens[0]);
+            timestamp = std::stoll(tokens[1]);
+        } catch (const std::exception&) {
+            broken = true;
+            break;
+        }
+        position += consumed;
+        if (tokens.size() > 2) {
+            // Пропуск записи означает расхождение с ведущим - такую связь нужно синхронизировать заново.
+            if (offset != replication->offset + 1) {
+                broken = true;
+                break;
+            }
+            tokens.erase(tokens.begin(), tokens.begin() + 2);
+            if (executeCommand(store, std::move(tokens), &discard)) modified++;
+            discard.length = 0;
+        }
+        replication->offset = offset;
+        replication->leaderTime = timestamp;
+        replication->lagMs = std::max<int64_t>(0, replicationClock() - timestamp);
+    }
+    destroyOutput(&discard);
+    if (broken) {
+        std::cerr << "ERROR: Replication stream from '" << replication->leaderPath << "' is out of sync, resyncing." << std::endl;
+        closeReplicationLink(store);
+        replication->retryAt = 0;
+        return modified;
+    }
+    replication->input.erase(0, position);
+    return modified;
+}
@@ -0,0 +1,29 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "Store.h"
+#include <vector>
+
+#define REPLICATION_HEARTBEAT_MS 1000
+#define REPLICATION_RETRY_MS 1000
+#define REPLICATION_SYNC_TIMEOUT_MS 10000
+
+// Ведомый подключается к сокету ведущего и отправляет SYNC. Ответ - массив RESP
+// [offset, байты снимка], дальше идёт поток записей [номер, время ведущего в мс, команда, аргументы...]
+// по одной на каждую изменяющую команду. Запись без команды - пульс: по нему ведомый
+// считает отставание, когда ведущий простаивает.
+
+// Время для меток потока: ведущий и ведомый работают на одной машине, поэтому часы общие.
+int64_t replicationClock();
+void writeReplicationEntry(struct OutputBuffer* out, uint64_t offset, int64_t timestamp, const std::vector<std::string>* tokens);
+// Снимок для нового ведомого пишется во временный файл рядом с основным и читается в bytes.
+bool readReplicationSnapshot(const struct DataStore* store, const std::string& filename, std::string* bytes);
+
+// Загружает снимок ведущего в filename и store и открывает поток. При ошибке связь остаётся
+// разорванной, следующая попытка - через REPLICATION_RETRY_MS.
+bool syncWithLeader(struct DataStore* store, const std::string& filename);
+// Читает доступные записи потока и применяет их. Возвращает число изменивших хранилище команд.
+int applyReplicationStream(struct DataStore* store);
+void closeReplicationLink(struct DataStore* store);
+
+#endif
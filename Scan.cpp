@@ -0,0 +1,92 @@
+#include "Scan.h"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+static std::atomic<int> scanSharers(1);
+
+void setScanSharers(int sharers) {
+    scanSharers.store(std::max(1, sharers), std::memory_order_relaxed);
+}
+
+int scanThreads(int64_t chunks) {
+    int64_t cores = std::thread::hardware_concurrency();
+    cores /= scanSharers.load(std::memory_order_relaxed);
+    if (cores < 1) cores = 1;
+    return static_cast<int>(std::min(cores, chunks));
+}
+
+// Поток шарда закреплён за одним ядром, и помощник унаследовал бы эту маску; помощникам
+// разрешены все ядра, а их общее число уже ограничено долей ядер на шард.
+static void releaseAffinity(std::thread& thread) {
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0) return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (unsigned i = 0; i < cores && i < CPU_SETSIZE; ++i) CPU_SET(static_cast<int>(i), &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+void parallelScan(int64_t chunks, const std::function<bool(int64_t)>& visit) {
+    std::atomic<int64_t> next(0);
+    std::atomic<bool> stop(false);
+    std::exception_ptr failure;
+    std::mutex failureLock;
+    auto worker = [&]() {
+        try {
+            while (!stop.load(std::memory_order_relaxed)) {
+                int64_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= chunks) break;
+                if (!visit(chunk)) stop.store(true, std::memory_order_relaxed);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(failureLock);
+            if (!failure) failure = std::current_exception();
+            stop.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    // Если поток не создался, его куски просто достанутся остальным.
+    std::vector<std::thread> helpers;
+    int threads = scanThreads(chunks);
+    helpers.reserve(threads);
+    for (int i = 1; i < threads; ++i) {
+        try {
+            helpers.emplace_back(worker);
+            releaseAffinity(helpers.back());
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+    worker();
+    for (std::thread& helper : helpers) helper.join();
+    if (failure) std::rethrow_exception(failure);
+}
+
+void parallelSort(std::string* data, int64_t size) {
+    int threads = size < SORT_PARALLEL_THRESHOLD ? 1 : scanThreads(size / (SORT_PARALLEL_THRESHOLD / 2));
+    int64_t parts = 1;
+    while (parts * 2 <= threads) parts *= 2;
+    if (parts == 1) {
+        std::sort(data, data + size);
+        return;
+    }
+
+    std::vector<int64_t> bounds(parts + 1);
+    for (int64_t i = 0; i <= parts; ++i) bounds[i] = size * i / parts;
+    parallelScan(parts, [&](int64_t part) {
+        std::sort(data + bounds[part], data + bounds[part + 1]);
+        return true;
+    });
+    for (int64_t width = 1; width < parts; width *= 2) {
+        parallelScan(parts / (2 * width), [&](int64_t pair) {
+            int64_t first = pair * 2 * width;
+            std::inplace_merge(data + bounds[first], data + bounds[first + width], data + bounds[first + 2 * width]);
+            return true;
+        });
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Последовательности короче SCAN_PARALLEL_THRESHOLD элементов просматриваются в вызывающем
+// потоке: запуск потоков обходится дороже самого прохода.
+#ifndef SCAN_PARALLEL_THRESHOLD
+#define SCAN_PARALLEL_THRESHOLD (1LL << 18)
+#endif
+#define SCAN_CHUNK (1LL << 14)
+#define SORT_PARALLEL_THRESHOLD (1LL << 16)
+#define SCAN_ALL std::numeric_limits<int64_t>::max()
+
+struct ScanResult {
+    int64_t matches;
+    int64_t visited;
+};
+
+// Сколько потоков стоит запустить на chunks кусков (включая вызывающий). Ядра делятся поровну
+// между sharers одновременно сканирующими потоками (шардами), см. setScanSharers.
+int scanThreads(int64_t chunks);
+void setScanSharers(int sharers);
+// Раздаёт куски 0..chunks-1 потокам через общий счётчик, по одному за раз. visit(i) возвращает
+// false, когда дальше смотреть незачем: остальные потоки больше не берут новых кусков.
+// Исключение из visit останавливает проход и пробрасывается вызывающему.
+void parallelScan(int64_t chunks, const std::function<bool(int64_t)>& visit);
+// Сортировка по возрастанию: части сортируются в своих потоках, затем сливаются попарно,
+// каждый уровень слияния - тоже параллельно. Меньше SORT_PARALLEL_THRESHOLD - обычный std::sort.
+void parallelSort(std::string* data, int64_t size);
+
+// Поиск value в последовательности с произвольным доступом, at(i) - i-й элемент. Останавливается,
+// набрав limit совпадений; positions, если задан, получает номера совпадений по возрастанию.
+template <typename At>
+struct ScanResult scanIndexed(int64_t size, std::string_view value, int64_t limit, std::vector<int64_t>* positions, At at) {
+    struct ScanResult result = {0, 0};
+    if (size < SCAN_PARALLEL_THRESHOLD) {
+        for (int64_t i = 0; i < size && result.matches < limit; ++i) {
+            ++result.visited;
+            if (at(i) != value) continue;
+            ++result.matches;
+            if (positions) positions->push_back(i);
+        }
+        return result;
+    }
+
+    int64_t chunks = (size + SCAN_CHUNK - 1) / SCAN_CHUNK;
+    std::vector<std::vector<int64_t>> hits(positions ? chunks : 0);
+    std::atomic<int64_t> matches(0), visited(0);
+    parallelScan(chunks, [&](int64_t chunk) {
+        int64_t begin = chunk * SCAN_CHUNK, end = std::min<int64_t>(size, begin + SCAN_CHUNK), found = 0;
+        for (int64_t i = begin; i < end; ++i) {
+            if (at(i) != value) continue;
+            ++found;
+            if (positions) hits[chunk].push_back(i);
+        }
+        visited.fetch_add(end - begin, std::memory_order_relaxed);
+        return matches.fetch_add(found, std::memory_order_relaxed) + found < limit;
+    });
+    result.matches = std::min(matches.load(), limit);
+    result.visited = visited.load();
+    for (const std::vector<int64_t>& chunkHits : hits) positions->insert(positions->end(), chunkHits.begin(), chunkHits.end());
+    return result;
+}
+
+#endif
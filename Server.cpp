@@ -0,0 +1,357 @@
+#include "Server.h"
+#include "Commands.h"
+#include "Protocol.h"
+#include "Replication.h"
+#include "Shards.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stopRequested = 0;
+
+// Состояние цикла сервера, общее для обработчиков запросов.
+struct ServerState {
+    struct DataStore* store;
+    const std::string* filePath;
+    struct ShardPool* pool;
+    std::deque<struct ShardTask> batch;
+    // Задачи пачки [0, streamed) уже переданы репликам.
+    size_t streamed;
+    std::vector<struct ServerClient*> replicas;
+    int64_t heartbeatAt;
+};
+
+static void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+static int openListener(const std::string& socketPath) {
+    struct sockaddr_un address;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "ERROR: Socket path '" << socketPath << "' is too long." << std::endl;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "ERROR: socket: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 128) < 0) {
+        std::cerr << "ERROR: Could not listen on '" << socketPath << "': " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void closeClient(struct ServerClient* client) {
+    destroyOutput(&client->out);
+    close(client->fd);
+    delete client;
+}
+
+static void replyHello(struct ServerClient* client, const std::vector<std::string>& tokens, struct OutputBuffer* out) {
+    if (tokens.size() > 1) {
+        if (tokens[1] == "3") client->out.format = RESP3_FORMAT;
+        else if (tokens[1] == "2") client->out.format = RESP2_FORMAT;
+        else {
+            replyError(out, ERR_FAILED, "NOPROTO unsupported protocol version");
+            return;
+        }
+        out->format = client->out.format;
+    }
+    replyMapBegin(out, 3);
+    replyValue(out, "server");
+    replyValue(out, "lab1sem3");
+    replyValue(out, "proto");
+    replyInteger(out, client->out.format == RESP3_FORMAT ? 3 : 2);
+    replyValue(out, "mode");
+    replyValue(out, "standalone");
+}
+
+// Команды соединения не трогают хранилище.
+static bool isConnectionCommand(const std::string& command) {
+    return command == "PING" || command == "HELLO" || command == "QUIT" || command == "COMMAND" || command == "CONFIG";
+}
+
+// В режиме шардов команда с именем структуры уходит в шард-владелец.
+static bool isRoutedCommand(const std::vector<std::string>& tokens) {
+    const std::string& command = tokens[0];
+    return tokens.size() > 1 && !isConnectionCommand(command) && command != "HELP" && command != "STATS" && command != "BGSAVE" && !isTreeSetCommand(command);
+}
+
+// Каждая изменяющая команда получает следующий номер; репликам уходит запись с ним и временем.
+static void streamToReplicas(struct ServerState* state, const std::vector<std::string>& tokens) {
+    uint64_t offset = ++state->store->replication.offset;
+    if (state->replicas.empty()) return;
+    int64_t timestamp = replicationClock();
+    for (struct ServerClient* replica : state->replicas) writeReplicationEntry(&replica->out, offset, timestamp, &tokens);
+}
+
+// С шардами изменения пачки известны только после выполнения: передаём их по порядку пачки.
+static void streamCompletedTasks(struct ServerState* state) {
+    for (size_t i = state->streamed; i < state->batch.size(); ++i) {
+        if (state->batch[i].modified) streamToReplicas(state, state->batch[i].tokens);
+    }
+    state->streamed = state->batch.size();
+}
+
+// SYNC: снимок берётся после всех уже выполненных команд, а следующие изменения идут потоком.
+static void attachReplica(struct ServerState* state, struct ServerClient* client, struct OutputBuffer* out) {
+    struct DataStore* store = state->store;
+    if (store->readOnly || store->replication.follower) {
+        replyError(out, ERR_READ_ONLY, "Реплика может подключаться только к ведущему хранилищу.");
+        return;
+    }
+    if (client->replica) {
+        replyError(out, ERR_FAILED, "Соединение уже является репликой.");
+        return;
+    }
+    streamCompletedTasks(state);
+    std::string snapshot;
+    if (!readReplicationSnapshot(store, *state->filePath, &snapshot)) {
+        replyError(out, ERR_FAILED, "Не удалось подготовить снимок для реплики.");
+        return;
+    }
+    replyArrayBegin(out, 2);
+    replyArrayItem(out, std::to_string(store->replication.offset));
+    replyArrayItem(out, snapshot);
+    replyArrayEnd(out);
+    client->replica = true;
+    state->replicas.push_back(client);
+    store->replication.replicaCount = static_cast<int>(state->replicas.size());
+}
+
+// Ответ пишется в out. Возвращает true, если команда изменила хранилище.
+static bool handleRequest(struct ServerState* state, struct ServerClient* client, std::vector<std::string>& tokens, struct OutputBuffer* out) {
+    struct DataStore* store = state->store;
+    const std::string& command = tokens[0];
+    if (command == "PING") {
+        if (tokens.size() > 1) replyValue(out, tokens[1]);
+        else writeRaw(out, "+PONG\r\n", 7);
+        return false;
+    }
+    if (command == "HELLO") {
+        replyHello(client, tokens, out);
+        return false;
+    }
+    if (command == "QUIT") {
+        replyOK(out);
+        client->closing = true;
+        return false;
+    }
+    if (command == "COMMAND" || command == "CONFIG") {
+        replyArrayBegin(out, 0);
+        return false;
+    }
+    if (command == "SYNC") {
+        attachReplica(state, client, out);
+        return false;
+    }
+    if (store->replication.follower && isWriteCommand(command)) {
+        replyError(out, ERR_READ_ONLY, "Реплика принимает только команды чтения.");
+        return false;
+    }
+    return executeCommand(store, tokens, out);
+}
+
+// С шардами каждая команда становится задачей пачки: ответы потом собираются по порядку.
+// Команды без шарда (STATS, BGSAVE, ...) читают все шарды, поэтому сначала ждём их.
+static void dispatchRequest(struct ServerState* state, struct ServerClient* client, std::vector<std::string>& tokens) {
+    struct ShardPool* pool = state->pool;
+    state->batch.emplace_back();
+    struct ShardTask* task = &state->batch.back();
+    task->client = client;
+    task->format = client->out.format;
+    task->modified = false;
+    if (isRoutedCommand(tokens)) {
+        task->shard = shardForName(tokens[1], pool->count);
+        task->tokens = std::move(tokens);
+        submitShardTask(pool, task);
+        return;
+    }
+    if (!isConnectionCommand(tokens[0])) waitShardPool(pool);
+    task->shard = -1;
+    task->tokens = std::move(tokens);
+    pool->local.format = client->out.format;
+    task->replyStart = pool->local.length;
+    task->modified = handleRequest(state, client, task->tokens, &pool->local);
+    task->replyEnd = pool->local.length;
+}
+
+// Выполняет все полностью принятые запросы клиента. Возвращает число изменивших хранилище команд
+// (с шардами команды только отправляются, и изменения считаются после ожидания пачки).
+static int processClientInput(struct ServerState* state, struct ServerClient* client) {
+    std::vector<std::string>& tokens = client->arguments;
+    int modified = 0;
+    size_t position = 0;
+    while (!client->closing && position < client->input.size()) {
+        size_t consumed = 0;
+        enum ParseResult result = parseRequest(client->input.data() + position, client->input.size() - position, &consumed, &tokens, &client->request);
+        if (result == PARSE_INCOMPLETE) break;
+        if (result == PARSE_ERROR) {
+            replyError(&client->out, ERR_SYNTAX, "Protocol error");
+            client->closing = true;
+            break;
+        }
+        position += consumed;
+        if (tokens.empty()) continue;
+        std::string& command = tokens[0];
+        std::transform(command.begin(), command.end(), command.begin(), [](unsigned char c) { return std::toupper(c); });
+        if (state->pool != nullptr) {
+            dispatchRequest(state, client, tokens);
+        } else if (handleRequest(state, client, tokens, &client->out)) {
+            streamToReplicas(state, tokens);
+            modified++;
+        }
+    }
+    client->input.erase(0, position);
+    return modified;
+}
+
+int runServer(struct DataStore* store, const std::string& socketPath, const std::string& filePath) {
+    int listener = openListener(socketPath);
+    if (listener < 0) return 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    std::vector<struct ServerClient*> clients;
+    std::vector<struct pollfd> pollSet;
+    char chunk[SERVER_READ_CHUNK];
+    struct ShardPool shardPool;
+    struct ServerState state;
+    state.store = store;
+    state.filePath = &filePath;
+    state.pool = nullptr;
+    state.streamed = 0;
+    state.heartbeatAt = 0;
+    if (store->shardCount > 0) {
+        startShardPool(&shardPool, store);
+        state.pool = &shardPool;
+    }
+    struct ShardPool* pool = state.pool;
+    struct ReplicationState* replication = &store->replication;
+
+    while (!stopRequested) {
+        if (replication->follower && replication->leaderFd < 0 && replicationClock() >= replication->retryAt) {
+            syncWithLeader(store, filePath);
+        }
+
+        pollSet.clear();
+        pollSet.push_back({listener, POLLIN, 0});
+        for (struct ServerClient* client : clients) pollSet.push_back({client->fd, POLLIN, 0});
+        size_t leaderIndex = pollSet.size();
+        if (replication->leaderFd >= 0) pollSet.push_back({replication->leaderFd, POLLIN, 0});
+
+        // Пока идёт BGSAVE, просыпаемся периодически, чтобы вовремя забрать дочерний процесс;
+        // ведущий с репликами просыпается ради пульса, ведомый без связи - ради новой попытки.
+        int timeout = store->background.child > 0 ? SERVER_BGSAVE_POLL_MS : -1;
+        bool waitsForLink = replication->follower && replication->leaderFd < 0;
+        if ((!state.replicas.empty() || waitsForLink) && (timeout < 0 || timeout > REPLICATION_HEARTBEAT_MS)) {
+            timeout = REPLICATION_HEARTBEAT_MS;
+        }
+        if (poll(pollSet.data(), pollSet.size(), timeout) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "ERROR: poll: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        if (store->readOnly) refreshReadOnlyStore(store, filePath);
+        int modified = 0;
+        if (leaderIndex < pollSet.size() && pollSet[leaderIndex].revents != 0) {
+            modified += applyReplicationStream(store);
+        }
+        for (size_t i = 1; i < leaderIndex; ++i) {
+            if (pollSet[i].revents == 0) continue;
+            struct ServerClient* client = clients[i - 1];
+            ssize_t received = read(client->fd, chunk, sizeof(chunk));
+            if (received <= 0) {
+                if (received < 0 && errno == EINTR) continue;
+                client->closing = true;
+                continue;
+            }
+            client->input.append(chunk, static_cast<size_t>(received));
+            modified += processClientInput(&state, client);
+        }
+
+        if (pool != nullptr) {
+            waitShardPool(pool);
+            for (const struct ShardTask& task : state.batch) {
+                if (task.modified) modified++;
+            }
+        }
+
+        // Сохраняем до отправки ответов: клиент видит OK только для уже записанных изменений
+        // (кроме --autosave и времени работы BGSAVE, когда запись откладывается).
+        persistChanges(store, filePath, modified);
+
+        if (pool != nullptr) {
+            for (size_t i = 0; i < state.batch.size(); ++i) {
+                const struct ShardTask& task = state.batch[i];
+                writeRaw(&task.client->out, shardReply(pool, &task), task.replyEnd - task.replyStart);
+                if (i >= state.streamed && task.modified) streamToReplicas(&state, task.tokens);
+            }
+            state.batch.clear();
+            state.streamed = 0;
+            resetShardReplies(pool);
+        }
+
+        if (!state.replicas.empty() && replicationClock() - state.heartbeatAt >= REPLICATION_HEARTBEAT_MS) {
+            state.heartbeatAt = replicationClock();
+            for (struct ServerClient* replica : state.replicas) {
+                writeReplicationEntry(&replica->out, replication->offset, state.heartbeatAt, nullptr);
+            }
+        }
+
+        for (size_t i = 0; i < clients.size();) {
+            flushOutput(&clients[i]->out);
+            if (clients[i]->closing) {
+                if (clients[i]->replica) {
+                    state.replicas.erase(std::find(state.replicas.begin(), state.replicas.end(), clients[i]));
+                    replication->replicaCount = static_cast<int>(state.replicas.size());
+                }
+                closeClient(clients[i]);
+                clients.erase(clients.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+
+        if (pollSet[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                if (clients.size() >= SERVER_MAX_CLIENTS) {
+                    close(fd);
+                } else {
+                    struct ServerClient* client = new ServerClient;
+                    client->fd = fd;
+                    client->closing = false;
+                    client->replica = false;
+                    resetRequestState(&client->request);
+                    initOutput(&client->out, fd, RESP2_FORMAT);
+                    clients.push_back(client);
+                }
+            }
+        }
+    }
+
+    if (pool != nullptr) stopShardPool(pool);
+    closeReplicationLink(store);
+    for (struct ServerClient* client : clients) closeClient(client);
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Protocol.h"
+#include "Store.h"
+#include <vector>
+
+#define SERVER_READ_CHUNK 65536
+#define SERVER_MAX_CLIENTS 1024
+#define SERVER_BGSAVE_POLL_MS 100
+
+struct ServerClient {
+    int fd;
+    std::string input;
+    // Недочитанный запрос в начале input: разобранные аргументы и место, где разбор остановился.
+    std::vector<std::string> arguments;
+    struct RequestState request;
+    struct OutputBuffer out;
+    bool closing;
+    // После SYNC соединение получает поток изменений ведущего.
+    bool replica;
+};
+
+// Обслуживает клиентов RESP2/RESP3 на Unix-сокете socketPath, пока не придёт SIGINT/SIGTERM.
+// Команды конвейера выполняются пачкой; если пачка что-то изменила, файл сохраняется один раз.
+// Если у store есть шарды, команды пачки выполняются потоками шардов параллельно.
+// Ведомый (store->replication.follower) читает поток ведущего и отвечает клиентам только на чтение.
+int runServer(struct DataStore* store, const std::string& socketPath, const std::string& filePath);
+
+#endif
@@ -0,0 +1,99 @@
+#include "Shards.h"
+#include "Commands.h"
+#include "Scan.h"
+#include <pthread.h>
+#include <sched.h>
+
+static void runShardWorker(struct ShardPool* pool, struct ShardWorker* worker) {
+    std::vector<struct ShardTask*> tasks;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(worker->lock);
+            worker->wake.wait(guard, [worker] { return worker->stopping || !worker->queue.empty(); });
+            if (worker->queue.empty()) return;
+            tasks.swap(worker->queue);
+        }
+        for (struct ShardTask* task : tasks) {
+            worker->out.format = task->format;
+            task->replyStart = worker->out.length;
+            task->modified = executeCommand(worker->store, task->tokens, &worker->out);
+            task->replyEnd = worker->out.length;
+        }
+        int finished = static_cast<int>(tasks.size());
+        tasks.clear();
+        if (pool->pending.fetch_sub(finished) == finished) {
+            std::lock_guard<std::mutex> guard(pool->doneLock);
+            pool->done.notify_all();
+        }
+    }
+}
+
+static void pinThread(std::thread& thread, int index) {
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0) return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(static_cast<int>(static_cast<unsigned>(index) % cores), &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+void startShardPool(struct ShardPool* pool, struct DataStore* store) {
+    pool->count = store->shardCount;
+    // Каждый шард может сканировать одновременно с остальными: без деления ядер вышло бы шарды x ядра потоков.
+    setScanSharers(pool->count);
+    pool->workers = new ShardWorker[pool->count];
+    pool->pending.store(0);
+    initOutput(&pool->local, -1, RESP2_FORMAT);
+    for (int i = 0; i < pool->count; ++i) {
+        struct ShardWorker* worker = &pool->workers[i];
+        worker->store = &store->shards[i];
+        worker->stopping = false;
+        initOutput(&worker->out, -1, RESP2_FORMAT);
+        worker->thread = std::thread(runShardWorker, pool, worker);
+        pinThread(worker->thread, i);
+    }
+}
+
+void stopShardPool(struct ShardPool* pool) {
+    for (int i = 0; i < pool->count; ++i) {
+        {
+            std::lock_guard<std::mutex> guard(pool->workers[i].lock);
+            pool->workers[i].stopping = true;
+        }
+        pool->workers[i].wake.notify_one();
+    }
+    for (int i = 0; i < pool->count; ++i) {
+        pool->workers[i].thread.join();
+        destroyOutput(&pool->workers[i].out);
+    }
+    destroyOutput(&pool->local);
+    delete[] pool->workers;
+    pool->workers = nullptr;
+    pool->count = 0;
+    setScanSharers(1);
+}
+
+void submitShardTask(struct ShardPool* pool, struct ShardTask* task) {
+    struct ShardWorker* worker = &pool->workers[task->shard];
+    pool->pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->queue.push_back(task);
+    }
+    worker->wake.notify_one();
+}
+
+void waitShardPool(struct ShardPool* pool) {
+    std::unique_lock<std::mutex> guard(pool->doneLock);
+    pool->done.wait(guard, [pool] { return pool->pending.load() == 0; });
+}
+
+const char* shardReply(const struct ShardPool* pool, const struct ShardTask* task) {
+    const struct OutputBuffer* out = task->shard < 0 ? &pool->local : &pool->workers[task->shard].out;
+    return out->data + task->replyStart;
+}
+
+void resetShardReplies(struct ShardPool* pool) {
+    for (int i = 0; i < pool->count; ++i) pool->workers[i].out.length = 0;
+    pool->local.length = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include "Store.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ServerClient;
+
+// Команда, отправленная в шард. Ответ пишется в буфер шарда, задача запоминает свой
+// диапазон [replyStart, replyEnd): так на каждую команду не нужен отдельный буфер.
+// shard < 0 - команда выполнена в основном потоке, ответ лежит в pool->local.
+struct ShardTask {
+    std::vector<std::string> tokens;
+    enum OutputFormat format;
+    int shard;
+    size_t replyStart;
+    size_t replyEnd;
+    bool modified;
+    struct ServerClient* client;
+};
+
+// Поток шарда - единственный, кто трогает store; под lock только очередь задач.
+struct ShardWorker {
+    struct DataStore* store;
+    struct OutputBuffer out;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<struct ShardTask*> queue;
+    bool stopping;
+};
+
+struct ShardPool {
+    struct ShardWorker* workers;
+    int count;
+    struct OutputBuffer local;
+    std::atomic<int> pending;
+    std::mutex doneLock;
+    std::condition_variable done;
+};
+
+// Запускает по потоку на каждый шард store->shards, поток i привязан к ядру i % число ядер.
+void startShardPool(struct ShardPool* pool, struct DataStore* store);
+void stopShardPool(struct ShardPool* pool);
+void submitShardTask(struct ShardPool* pool, struct ShardTask* task);
+// Ждёт, пока шарды выполнят все отправленные задачи; после этого их хранилища можно читать.
+void waitShardPool(struct ShardPool* pool);
+const char* shardReply(const struct ShardPool* pool, const struct ShardTask* task);
+// Сбрасывает буферы ответов; вызывать после waitShardPool, когда ответы уже скопированы.
+void resetShardReplies(struct ShardPool* pool);
+
+#endif
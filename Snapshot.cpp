@@ -0,0 +1,138 @@
+#include "Snapshot.h"
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool isSnapshotFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    char magic[SNAPSHOT_MAGIC_LENGTH];
+    bool result = read(fd, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic)) &&
+                  memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) == 0;
+    close(fd);
+    return result;
+}
+
+bool openSnapshot(struct SnapshotFile* snapshot, const std::string& filename) {
+    snapshot->data = nullptr;
+    snapshot->size = 0;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(struct SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+    snapshot->data = static_cast<const char*>(mapped);
+    snapshot->size = static_cast<size_t>(info.st_size);
+    snapshot->inode = static_cast<uint64_t>(info.st_ino);
+    snapshot->modifiedAt = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+    const struct SnapshotHeader* header = reinterpret_cast<const struct SnapshotHeader*>(snapshot->data);
+    uint64_t directoryEnd = sizeof(struct SnapshotHeader) +
+                            static_cast<uint64_t>(header->entryCount) * sizeof(struct SnapshotDirectoryEntry);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) != 0 ||
+        header->version != SNAPSHOT_VERSION || directoryEnd > snapshot->size) {
+        closeSnapshot(snapshot);
+        return false;
+    }
+    const struct SnapshotDirectoryEntry* directory = snapshotDirectory(snapshot);
+    for (uint32_t i = 0; i < header->entryCount; ++i) {
+        if (directory[i].offset % SNAPSHOT_ALIGNMENT != 0 || directory[i].offset > snapshot->size ||
+            directory[i].length > snapshot->size - directory[i].offset) {
+            closeSnapshot(snapshot);
+            return false;
+        }
+    }
+    return true;
+}
+
+void closeSnapshot(struct SnapshotFile* snapshot) {
+    if (snapshot->data != nullptr) {
+        munmap(const_cast<char*>(snapshot->data), snapshot->size);
+    }
+    snapshot->data = nullptr;
+    snapshot->size = 0;
+}
+
+uint32_t snapshotEntryCount(const struct SnapshotFile* snapshot) {
+    return reinterpret_cast<const struct SnapshotHeader*>(snapshot->data)->entryCount;
+}
+
+const struct SnapshotDirectoryEntry* snapshotDirectory(const struct SnapshotFile* snapshot) {
+    return reinterpret_cast<const struct SnapshotDirectoryEntry*>(snapshot->data + sizeof(struct SnapshotHeader));
+}
+
+bool readSectionView(const struct SnapshotFile* snapshot, uint64_t offset, uint64_t length, struct SectionView* view) {
+    if (length < 2 * sizeof(uint64_t)) return false;
+    const uint64_t* section = reinterpret_cast<const uint64_t*>(snapshot->data + offset);
+    uint64_t count = section[0];
+    if (count > (length / sizeof(uint64_t)) - 2) return false;
+    view->count = count;
+    view->offsets = section + 1;
+    view->values = reinterpret_cast<const char*>(section + count + 2);
+    uint64_t valueBytes = length - (count + 2) * sizeof(uint64_t);
+    if (view->offsets[count] > valueBytes) return false;
+    return true;
+}
+
+bool checkSectionOffsets(const struct SectionView* view) {
+    for (uint64_t i = 0; i < view->count; ++i) {
+        if (view->offsets[i] > view->offsets[i + 1]) return false;
+    }
+    return true;
+}
+
+std::string_view sectionValue(const struct SectionView* view, uint64_t index) {
+    return std::string_view(view->values + view->offsets[index], view->offsets[index + 1] - view->offsets[index]);
+}
+
+uint64_t sectionSize(uint64_t count, uint64_t valueBytes) {
+    uint64_t size = (count + 2) * sizeof(uint64_t) + valueBytes;
+    return (size + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+bool snapshotChanged(const struct SnapshotFile* snapshot, const std::string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) < 0) return false;
+    int64_t modifiedAt = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return snapshot->data == nullptr || static_cast<uint64_t>(info.st_ino) != snapshot->inode || modifiedAt != snapshot->modifiedAt;
+}
+
+bool sectionContains(const struct SectionView* view, std::string_view value) {
+    return sectionFind(view, value, 1, nullptr).matches > 0;
+}
+
+struct ScanResult sectionFind(const struct SectionView* view, std::string_view value, int64_t limit, std::vector<int64_t>* positions) {
+    return scanIndexed(static_cast<int64_t>(view->count), value, limit, positions, [view](int64_t i) { return sectionValue(view, static_cast<uint64_t>(i)); });
+}
+
+bool sectionSortedContains(const struct SectionView* view, std::string_view value) {
+    uint64_t low = sectionLowerBound(view, value);
+    return low < view->count && sectionValue(view, low) == value;
+}
+
+uint64_t sectionLowerBound(const struct SectionView* view, std::string_view value) {
+    uint64_t low = 0, high = view->count;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (sectionValue(view, middle) < value) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+void printSection(const struct SectionView* view, bool reversed, uint64_t offset, uint64_t limit, struct OutputBuffer* out) {
+    uint64_t count = offset >= view->count ? 0 : std::min(limit, view->count - offset);
+    replyArrayBegin(out, count);
+    for (uint64_t i = offset; i < offset + count; ++i) {
+        replyArrayItem(out, sectionValue(view, reversed ? view->count - 1 - i : i));
+    }
+    replyArrayEnd(out);
+}
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "DataStructures.h"
+#include "Scan.h"
+#include <cstdint>
+#include <string_view>
+
+#define SNAPSHOT_MAGIC "LAB1SNAP"
+#define SNAPSHOT_MAGIC_LENGTH 8
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 8
+// SnapshotDirectoryEntry.flags: ARRAY отсортирован (MSORT) или HSET записан по возрастанию -
+// секция упорядочена, и поиск в ней двоичный.
+#define SNAPSHOT_FLAG_SORTED 1u
+
+// Формат файла:
+//   SnapshotHeader
+//   SnapshotDirectoryEntry[entryCount]   - имя -> смещение секции
+//   секции, выровненные на 8 байт:
+//     uint64_t count; uint64_t offsets[count + 1]; байты значений подряд.
+// Значение i занимает [offsets[i], offsets[i + 1]) от начала блока значений.
+// Порядок значений: ARRAY/FLIST/LLIST/QUEUE - от начала к концу, STACK - снизу вверх,
+// TREE, BTREE и VTREE - по возрастанию, HSET - по возрастанию с SNAPSHOT_FLAG_SORTED (в снимках
+// без флага - в порядке слотов таблицы), PQUEUE - в порядке массива кучи (первым - наименьший).
+struct SnapshotHeader {
+    char magic[SNAPSHOT_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t entryCount;
+};
+
+struct SnapshotDirectoryEntry {
+    uint32_t type;
+    uint32_t flags;
+    char name[MAX_NAME_LENGTH];
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct SnapshotFile {
+    const char* data;
+    size_t size;
+    uint64_t inode;
+    int64_t modifiedAt;
+};
+
+struct SectionView {
+    uint64_t count;
+    const uint64_t* offsets;
+    const char* values;
+};
+
+bool isSnapshotFile(const std::string& filename);
+bool openSnapshot(struct SnapshotFile* snapshot, const std::string& filename);
+void closeSnapshot(struct SnapshotFile* snapshot);
+uint32_t snapshotEntryCount(const struct SnapshotFile* snapshot);
+const struct SnapshotDirectoryEntry* snapshotDirectory(const struct SnapshotFile* snapshot);
+bool readSectionView(const struct SnapshotFile* snapshot, uint64_t offset, uint64_t length, struct SectionView* view);
+// Смещения не убывают - вместе с проверкой offsets[count] в readSectionView это значит, что
+// каждое значение лежит внутри секции. O(count), поэтому вызывается один раз на секцию.
+bool checkSectionOffsets(const struct SectionView* view);
+std::string_view sectionValue(const struct SectionView* view, uint64_t index);
+uint64_t sectionSize(uint64_t count, uint64_t valueBytes);
+bool snapshotChanged(const struct SnapshotFile* snapshot, const std::string& filename);
+
+bool sectionContains(const struct SectionView* view, std::string_view value);
+// Линейный поиск по секции, как у scanIndexed: не больше limit совпадений, номера - в positions.
+struct ScanResult sectionFind(const struct SectionView* view, std::string_view value, int64_t limit, std::vector<int64_t>* positions);
+bool sectionSortedContains(const struct SectionView* view, std::string_view value);
+uint64_t sectionLowerBound(const struct SectionView* view, std::string_view value);
+void printSection(const struct SectionView* view, bool reversed, uint64_t offset, uint64_t limit, struct OutputBuffer* out);
+
+#endif
@@ -1,9 +1,16 @@
 #include "Store.h"
 #include <fstream>
 #include <sstream>
-#include <functional>
+#include <vector>
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
+#include <cstdio>
+#include <functional>
+#include <chrono>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/wait.h>
 
 void initializeStore(struct DataStore* store) {
     for (int i = 0; i < MAX_STRUCTURES; ++i) {
@@ -11,11 +18,50 @@ void initializeStore(struct DataStore* store) {
         store->entries[i].dataPtr = nullptr;
         store->entries[i].type = NONE_TYPE;
         store->entries[i].name[0] = '\0';
+        store->entries[i].isLoaded = false;
+        store->entries[i].version = 0;
+        store->entries[i].printCache.valid = false;
     }
     store->count = 0;
+    store->snapshot.data = nullptr;
+    store->snapshot.size = 0;
+    store->readOnly = false;
+    store->refreshCheckedAt = 0;
+    store->background.child = 0;
+    store->background.resultFd = -1;
+    store->background.startedAt = 0;
+    store->background.lastDurationMs = 0;
+    store->background.lastStatus = SAVE_NONE;
+    store->background.autoSaveChanges = 0;
+    store->background.pendingChanges = 0;
+    store->background.savedChanges = 0;
+    store->shards = nullptr;
+    store->shardCount = 0;
+    store->printCacheClock = 0;
+    store->replication.follower = false;
+    store->replication.leaderFd = -1;
+    store->replication.offset = 0;
+    store->replication.leaderTime = 0;
+    store->replication.lagMs = 0;
+    store->replication.retryAt = 0;
+    store->replication.replicaCount = 0;
 }
 
-struct StoreEntry* findEntry(struct DataStore* store, const std::string& name) {
+void createShards(struct DataStore* store, int shardCount) {
+    store->shards = new DataStore[shardCount];
+    store->shardCount = shardCount;
+    for (int i = 0; i < shardCount; ++i) {
+        initializeStore(&store->shards[i]);
+        store->shards[i].readOnly = store->readOnly;
+        store->shards[i].filePath = store->filePath;
+    }
+}
+
+int shardForName(const std::string& name, int shardCount) {
+    return static_cast<int>(std::hash<std::string>()(name) % static_cast<size_t>(shardCount));
+}
+
+static struct StoreEntry* findEntrySlot(struct DataStore* store, const std::string& name) {
     for (int i = 0; i < MAX_STRUCTURES; ++i) {
         if (store->entries[i].isUsed && name == store->entries[i].name) {
             return &store->entries[i];
@@ -24,54 +70,227 @@ struct StoreEntry* findEntry(struct DataStore* store, const std::string& name) {
     return nullptr;
 }
 
-struct StoreEntry* findFreeEntry(struct DataStore* store) {
-    if (store->count >= MAX_STRUCTURES) return nullptr;
-    for (int i = 0; i < MAX_STRUCTURES; ++i) {
-        if (!store->entries[i].isUsed) {
-            return &store->entries[i];
-        }
+struct StoreEntry* findEntry(struct DataStore* store, const std::string& name) {
+    struct StoreEntry* entry = findEntrySlot(store, name);
+    if (entry && !entry->isLoaded && !store->readOnly) materializeEntry(store, entry);
+    return entry;
+}
+
+// xCREATE может выделять память (начальная ёмкость массива, таблица множества); если он бросит,
+// сам объект освобождается здесь.
+template <typename Structure>
+static Structure* newStructure(void (*create)(Structure*)) {
+    Structure* structure = new Structure;
+    try {
+        create(structure);
+    } catch (...) {
+        delete structure;
+        throw;
     }
-    return nullptr;
+    return structure;
 }
 
-void destroyEntryData(struct StoreEntry* entry) {
-    if (!entry || !entry->isUsed) return;
-    switch (entry->type) {
+static void* allocateStructure(enum StructureType type) {
+    switch (type) {
+        case ARRAY_TYPE: return newStructure<DynamicArray>(MCREATE);
+        case FLIST_TYPE: return newStructure<SinglyLinkedList>(FCREATE);
+        case LLIST_TYPE: return newStructure<DoublyLinkedList>(LCREATE);
+        case STACK_TYPE: return newStructure<Stack>(SCREATE);
+        case QUEUE_TYPE: return newStructure<Queue>(QCREATE);
+        case TREE_TYPE: return newStructure<AVLTree>(TCREATE);
+        case BTREE_TYPE: return newStructure<BPlusTree>(BCREATE);
+        case HSET_TYPE: return newStructure<HashSet>(HCREATE);
+        case PQUEUE_TYPE: return newStructure<PriorityQueue>(PCREATE);
+        case VTREE_TYPE: return newStructure<VersionedTree>(VCREATE);
+        default: break;
+    }
+    throw std::runtime_error("Invalid structure type.");
+}
+
+// Пара к allocateStructure: освобождает структуру типа type вместе с содержимым.
+static void destroyStructure(enum StructureType type, void* data) {
+    switch (type) {
         case ARRAY_TYPE:
-            MDESTROY(static_cast<DynamicArray*>(entry->dataPtr));
-            delete static_cast<DynamicArray*>(entry->dataPtr);
+            MDESTROY(static_cast<DynamicArray*>(data));
+            delete static_cast<DynamicArray*>(data);
             break;
         case FLIST_TYPE:
-            FDESTROY(static_cast<SinglyLinkedList*>(entry->dataPtr));
-            delete static_cast<SinglyLinkedList*>(entry->dataPtr);
+            FDESTROY(static_cast<SinglyLinkedList*>(data));
+            delete static_cast<SinglyLinkedList*>(data);
             break;
         case LLIST_TYPE:
-            LDESTROY(static_cast<DoublyLinkedList*>(entry->dataPtr));
-            delete static_cast<DoublyLinkedList*>(entry->dataPtr);
+            LDESTROY(static_cast<DoublyLinkedList*>(data));
+            delete static_cast<DoublyLinkedList*>(data);
             break;
         case STACK_TYPE:
-            SDESTROY(static_cast<Stack*>(entry->dataPtr));
-            delete static_cast<Stack*>(entry->dataPtr);
+            SDESTROY(static_cast<Stack*>(data));
+            delete static_cast<Stack*>(data);
             break;
         case QUEUE_TYPE:
-            QDESTROY(static_cast<Queue*>(entry->dataPtr));
-            delete static_cast<Queue*>(entry->dataPtr);
+            QDESTROY(static_cast<Queue*>(data));
+            delete static_cast<Queue*>(data);
             break;
         case TREE_TYPE:
-            TDESTROY(static_cast<AVLTree*>(entry->dataPtr));
-            delete static_cast<AVLTree*>(entry->dataPtr);
+            TDESTROY(static_cast<AVLTree*>(data));
+            delete static_cast<AVLTree*>(data);
+            break;
+        case BTREE_TYPE:
+            BDESTROY(static_cast<BPlusTree*>(data));
+            delete static_cast<BPlusTree*>(data);
+            break;
+        case HSET_TYPE:
+            HDESTROY(static_cast<HashSet*>(data));
+            delete static_cast<HashSet*>(data);
+            break;
+        case PQUEUE_TYPE:
+            PDESTROY(static_cast<PriorityQueue*>(data));
+            delete static_cast<PriorityQueue*>(data);
+            break;
+        case VTREE_TYPE:
+            VDESTROY(static_cast<VersionedTree*>(data));
+            delete static_cast<VersionedTree*>(data);
             break;
         default:
             break;
     }
+}
+
+bool entrySectionView(struct DataStore* store, struct StoreEntry* entry, struct SectionView* view) {
+    if (!readSectionView(&store->snapshot, entry->sectionOffset, entry->sectionLength, view)) return false;
+    if (!entry->sectionChecked) {
+        if (!checkSectionOffsets(view)) return false;
+        entry->sectionChecked = true;
+    }
+    return true;
+}
+
+// Снимок пишет деревья по возрастанию, поэтому TREE и VTREE собираются сразу сбалансированными;
+// поэлементная вставка остаётся на случай, если порядок в секции нарушен.
+static bool loadSortedTree(enum StructureType type, void* data, const struct SectionView* view) {
+    if (type != TREE_TYPE && type != VTREE_TYPE) return false;
+    std::vector<std::string_view> values;
+    values.reserve(view->count);
+    for (uint64_t i = 0; i < view->count; ++i) values.push_back(sectionValue(view, i));
+    if (type == TREE_TYPE) return TLOAD_SORTED(static_cast<AVLTree*>(data), values);
+    return VLOAD_SORTED(static_cast<VersionedTree*>(data), values);
+}
+
+static void fillStructure(enum StructureType type, uint32_t flags, void* data, const struct SectionView* view) {
+    if (loadSortedTree(type, data, view)) return;
+    for (uint64_t i = 0; i < view->count; ++i) {
+        std::string value(sectionValue(view, i));
+        switch (type) {
+            case ARRAY_TYPE:
+                if (i == 0) MGROW(static_cast<DynamicArray*>(data), static_cast<int64_t>(view->count));
+                MPUSH_BACK(static_cast<DynamicArray*>(data), std::move(value));
+                break;
+            case FLIST_TYPE: FPUSH_TAIL(static_cast<SinglyLinkedList*>(data), std::move(value)); break;
+            case LLIST_TYPE: LPUSH_TAIL(static_cast<DoublyLinkedList*>(data), std::move(value)); break;
+            case STACK_TYPE:
+                if (i == 0) MGROW(&static_cast<Stack*>(data)->items, static_cast<int64_t>(view->count));
+                SPUSH(static_cast<Stack*>(data), std::move(value));
+                break;
+            case QUEUE_TYPE: QPUSH(static_cast<Queue*>(data), std::move(value)); break;
+            case TREE_TYPE: TINSERT(static_cast<AVLTree*>(data), std::move(value)); break;
+            case BTREE_TYPE: BINSERT(static_cast<BPlusTree*>(data), std::move(value)); break;
+            case HSET_TYPE:
+                if (i == 0) HRESERVE(static_cast<HashSet*>(data), static_cast<int64_t>(view->count));
+                HADD(static_cast<HashSet*>(data), std::move(value));
+                break;
+            case PQUEUE_TYPE:
+                if (i == 0) MGROW(&static_cast<PriorityQueue*>(data)->heap, static_cast<int64_t>(view->count));
+                PAPPEND(static_cast<PriorityQueue*>(data), std::move(value));
+                break;
+            case VTREE_TYPE: VINSERT(static_cast<VersionedTree*>(data), std::move(value)); break;
+            default: break;
+        }
+    }
+    if (type == PQUEUE_TYPE) PHEAPIFY(static_cast<PriorityQueue*>(data));
+    if (type == ARRAY_TYPE) static_cast<DynamicArray*>(data)->sorted = (flags & SNAPSHOT_FLAG_SORTED) != 0;
+}
+
+void materializeEntry(struct DataStore* store, struct StoreEntry* entry) {
+    struct SectionView view;
+    if (!entrySectionView(store, entry, &view)) {
+        throw std::runtime_error("Corrupted snapshot section for '" + std::string(entry->name) + "'.");
+    }
+    void* data = allocateStructure(entry->type);
+    // Структура ещё не привязана к записи: если заполнение бросит (bad_alloc), освобождаем её здесь.
+    try {
+        fillStructure(entry->type, entry->sectionFlags, data, &view);
+    } catch (...) {
+        destroyStructure(entry->type, data);
+        throw;
+    }
+    entry->dataPtr = data;
+    entry->isLoaded = true;
+}
+
+struct StoreEntry* findFreeEntry(struct DataStore* store) {
+    if (store->count >= MAX_STRUCTURES) return nullptr;
+    for (int i = 0; i < MAX_STRUCTURES; ++i) {
+        if (!store->entries[i].isUsed) {
+            return &store->entries[i];
+        }
+    }
+    return nullptr;
+}
+
+void destroyEntryData(struct StoreEntry* entry) {
+    if (!entry || !entry->isUsed) return;
+    if (entry->isLoaded) destroyStructure(entry->type, entry->dataPtr);
+    releasePrintCache(entry);
     entry->dataPtr = nullptr;
     entry->isUsed = false;
+    entry->isLoaded = false;
     entry->type = NONE_TYPE;
     entry->name[0] = '\0';
 }
 
-void* createAndAddStructure(struct DataStore* store, const std::string& name, enum StructureType type) {
-    struct StoreEntry* entry = findEntry(store, name);
+void markEntryModified(struct StoreEntry* entry) {
+    entry->version++;
+}
+
+const std::string* findPrintCache(struct DataStore* store, struct StoreEntry* entry, enum OutputFormat format, bool isScan, int64_t offset, int64_t limit) {
+    struct PrintCache* cache = &entry->printCache;
+    if (!cache->valid || cache->version != entry->version || cache->format != format || cache->isScan != isScan || cache->offset != offset || cache->limit != limit) return nullptr;
+    cache->usedAt = ++store->printCacheClock;
+    return &cache->reply;
+}
+
+void storePrintCache(struct DataStore* store, struct StoreEntry* entry, enum OutputFormat format, bool isScan, int64_t offset, int64_t limit, std::string&& reply) {
+    releasePrintCache(entry);
+    if (reply.capacity() > static_cast<size_t>(PRINT_CACHE_BUDGET)) return;
+    for (;;) {
+        size_t used = 0;
+        struct StoreEntry* oldest = nullptr;
+        for (int i = 0; i < MAX_STRUCTURES; ++i) {
+            struct StoreEntry* other = &store->entries[i];
+            if (!other->isUsed || other->printCache.reply.empty()) continue;
+            used += other->printCache.reply.capacity();
+            if (!oldest || other->printCache.usedAt < oldest->printCache.usedAt) oldest = other;
+        }
+        if (!oldest || used + reply.capacity() <= static_cast<size_t>(PRINT_CACHE_BUDGET)) break;
+        releasePrintCache(oldest);
+    }
+    struct PrintCache* cache = &entry->printCache;
+    cache->reply = std::move(reply);
+    cache->valid = true;
+    cache->version = entry->version;
+    cache->format = format;
+    cache->isScan = isScan;
+    cache->offset = offset;
+    cache->limit = limit;
+    cache->usedAt = ++store->printCacheClock;
+}
+
+void releasePrintCache(struct StoreEntry* entry) {
+    entry->printCache.valid = false;
+    std::string().swap(entry->printCache.reply);
+}
+
+static struct StoreEntry* addEntry(struct DataStore* store, const std::string& name, enum StructureType type) {
+    struct StoreEntry* entry = findEntrySlot(store, name);
     if(entry) {
         destroyEntryData(entry);
         store->count--;
@@ -79,40 +298,25 @@ void* createAndAddStructure(struct DataStore* store, const std::string& name, en
 
     entry = findFreeEntry(store);
     if (!entry) throw std::runtime_error("Maximum number of structures reached.");
-    void* newData = nullptr;
-    if (type == ARRAY_TYPE) {
-        DynamicArray* arr = new DynamicArray;
-        MCREATE(arr);
-        newData = arr;
-    } else if (type == FLIST_TYPE) {
-        SinglyLinkedList* list = new SinglyLinkedList;
-        FCREATE(list);
-        newData = list;
-    } else if (type == LLIST_TYPE) {
-        DoublyLinkedList* list = new DoublyLinkedList;
-        LCREATE(list);
-        newData = list;
-    } else if (type == STACK_TYPE) {
-        Stack* stack = new Stack;
-        SCREATE(stack);
-        newData = stack;
-    } else if (type == QUEUE_TYPE) {
-        Queue* queue = new Queue;
-        QCREATE(queue);
-        newData = queue;
-    } else if (type == TREE_TYPE) {
-        AVLTree* tree = new AVLTree;
-        TCREATE(tree);
-        newData = tree;
-    } else {
-        throw std::runtime_error("Invalid structure type.");
-    }
     strncpy(entry->name, name.c_str(), MAX_NAME_LENGTH - 1);
     entry->name[MAX_NAME_LENGTH - 1] = '\0';
     entry->type = type;
-    entry->dataPtr = newData;
+    entry->dataPtr = nullptr;
     entry->isUsed = true;
+    entry->isLoaded = false;
+    entry->sectionFlags = 0;
+    entry->sectionChecked = false;
+    entry->counters = OpCounters();
+    entry->version = 0;
     store->count++;
+    return entry;
+}
+
+void* createAndAddStructure(struct DataStore* store, const std::string& name, enum StructureType type) {
+    void* newData = allocateStructure(type);
+    struct StoreEntry* entry = addEntry(store, name, type);
+    entry->dataPtr = newData;
+    entry->isLoaded = true;
     return newData;
 }
 
@@ -123,77 +327,277 @@ void destroyStore(struct DataStore* store) {
         }
     }
     store->count = 0;
+    closeSnapshot(&store->snapshot);
+    if (store->shards != nullptr) {
+        for (int i = 0; i < store->shardCount; ++i) destroyStore(&store->shards[i]);
+        delete[] store->shards;
+        store->shards = nullptr;
+        store->shardCount = 0;
+    }
 }
 
-void saveToFile(const struct DataStore* store, const std::string& filename) {
-    if (filename.empty()) return;
-    std::ofstream file(filename);
+// Обходит значения структуры в порядке секции снимка (см. Snapshot.h).
+template <typename Visitor>
+static void visitValues(const struct StoreEntry* entry, Visitor& visit) {
+    if (entry->type == ARRAY_TYPE) {
+        DynamicArray* arr = static_cast<DynamicArray*>(entry->dataPtr);
+        for (int64_t j = 0; j < arr->size; ++j) visit(arr->elements[j]);
+    } else if (entry->type == FLIST_TYPE) {
+        SinglyLinkedList* list = static_cast<SinglyLinkedList*>(entry->dataPtr);
+        for (struct FNode* current = list->head; current; current = current->next) visit(current->data);
+    } else if (entry->type == LLIST_TYPE) {
+        DoublyLinkedList* list = static_cast<DoublyLinkedList*>(entry->dataPtr);
+        for (struct LNode* current = list->head; current; current = current->next) {
+            for (int slot = 0; slot < current->count; ++slot) visit(current->values[slot]);
+        }
+    } else if (entry->type == STACK_TYPE) {
+        DynamicArray* items = &static_cast<Stack*>(entry->dataPtr)->items;
+        for (int64_t j = 0; j < items->size; ++j) visit(items->elements[j]);
+    } else if (entry->type == QUEUE_TYPE) {
+        Queue* queue = static_cast<Queue*>(entry->dataPtr);
+        for (struct FNode* current = queue->front; current; current = current->next) visit(current->data);
+    } else if (entry->type == TREE_TYPE) {
+        AVLTree* tree = static_cast<AVLTree*>(entry->dataPtr);
+        std::vector<struct TNode*> path;
+        struct TNode* current = tree->root;
+        while (current || !path.empty()) {
+            while (current) { path.push_back(current); current = current->left; }
+            current = path.back();
+            path.pop_back();
+            visit(current->data);
+            current = current->right;
+        }
+    } else if (entry->type == BTREE_TYPE) {
+        BPlusTree* tree = static_cast<BPlusTree*>(entry->dataPtr);
+        for (struct BNode* leaf = tree->firstLeaf; leaf; leaf = leaf->next) {
+            for (int j = 0; j < leaf->count; ++j) visit(leaf->keys[j]);
+        }
+    } else if (entry->type == HSET_TYPE) {
+        HashSet* set = static_cast<HashSet*>(entry->dataPtr);
+        const struct HashTable* tables[2] = {&set->current, &set->old};
+        for (const struct HashTable* table : tables) {
+            for (int64_t j = 0; j < table->capacity; ++j) {
+                if (table->control[j] >= 0) visit(table->slots[j]);
+            }
+        }
+    } else if (entry->type == PQUEUE_TYPE) {
+        DynamicArray* heap = &static_cast<PriorityQueue*>(entry->dataPtr)->heap;
+        for (int64_t j = 0; j < heap->size; ++j) visit(heap->elements[j]);
+    } else if (entry->type == VTREE_TYPE) {
+        const VersionedTree* tree = static_cast<const VersionedTree*>(entry->dataPtr);
+        struct VTreeReadGuard read(tree);
+        std::vector<const struct VNode*> path;
+        const struct VNode* current = read.root;
+        while (current || !path.empty()) {
+            while (current) { path.push_back(current); current = current->left; }
+            current = path.back();
+            path.pop_back();
+            visit(current->data);
+            current = current->right;
+        }
+    }
+}
+
+static void writePadding(std::ofstream& file, uint64_t written) {
+    static const char zeros[SNAPSHOT_ALIGNMENT] = {0};
+    uint64_t padding = (SNAPSHOT_ALIGNMENT - written % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+    file.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+static bool writeSnapshot(const struct DataStore* store, const std::string& filename, const std::string& tempName) {
+    std::vector<struct SnapshotDirectoryEntry> directory;
+    std::vector<std::pair<const struct DataStore*, const struct StoreEntry*>> saved;
+    int partCount = store->shardCount > 0 ? store->shardCount : 1;
+    for (int i = 0; i < partCount * MAX_STRUCTURES; ++i) {
+        const struct DataStore* part = store->shardCount > 0 ? &store->shards[i / MAX_STRUCTURES] : store;
+        const struct StoreEntry* entry = &part->entries[i % MAX_STRUCTURES];
+        if (!entry->isUsed || entry->type == NONE_TYPE) continue;
+        struct SnapshotDirectoryEntry record;
+        memset(&record, 0, sizeof(record));
+        record.type = static_cast<uint32_t>(entry->type);
+        strncpy(record.name, entry->name, MAX_NAME_LENGTH - 1);
+        if (entry->isLoaded) {
+            uint64_t count = 0, valueBytes = 0;
+            auto measure = [&](const std::string& value) { count++; valueBytes += value.size(); };
+            visitValues(entry, measure);
+            record.length = sectionSize(count, valueBytes);
+            if (entry->type == ARRAY_TYPE && static_cast<const DynamicArray*>(entry->dataPtr)->sorted) record.flags |= SNAPSHOT_FLAG_SORTED;
+            if (entry->type == HSET_TYPE) record.flags |= SNAPSHOT_FLAG_SORTED;
+        } else {
+            record.length = entry->sectionLength;
+            record.flags = entry->sectionFlags;
+        }
+        directory.push_back(record);
+        saved.push_back({part, entry});
+    }
+
+    uint64_t offset = sizeof(struct SnapshotHeader) + directory.size() * sizeof(struct SnapshotDirectoryEntry);
+    offset = (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    for (struct SnapshotDirectoryEntry& record : directory) {
+        record.offset = offset;
+        offset += record.length;
+    }
+
+    // Пишем во временный файл и атомарно подменяем: читатели старого снимка (в т.ч. ленивые
+    // записи этого же хранилища) продолжают видеть прежнее содержимое.
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
     if (!file.is_open()) {
         std::cerr << "ERROR: Could not open file '" << filename << "' for writing." << std::endl;
-        return;
+        return false;
     }
-    for (int i = 0; i < MAX_STRUCTURES; ++i) {
-        const struct StoreEntry* entry = &store->entries[i];
-        if (!entry->isUsed) continue;
-        switch (entry->type) {
-            case ARRAY_TYPE: file << "ARRAY "; break;
-            case FLIST_TYPE: file << "FLIST "; break;
-            case LLIST_TYPE: file << "LLIST "; break;
-            case STACK_TYPE: file << "STACK "; break;
-            case QUEUE_TYPE: file << "QUEUE "; break;
-            case TREE_TYPE: file << "TREE "; break;
-            default: continue;
+    struct SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH);
+    header.version = SNAPSHOT_VERSION;
+    header.entryCount = static_cast<uint32_t>(directory.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(directory.data()), static_cast<std::streamsize>(directory.size() * sizeof(struct SnapshotDirectoryEntry)));
+    writePadding(file, sizeof(header) + directory.size() * sizeof(struct SnapshotDirectoryEntry));
+
+    for (size_t i = 0; i < saved.size(); ++i) {
+        const struct StoreEntry* entry = saved[i].second;
+        if (!entry->isLoaded) {
+            file.write(saved[i].first->snapshot.data + entry->sectionOffset, static_cast<std::streamsize>(entry->sectionLength));
+            continue;
         }
-        file << entry->name;
-        if (entry->type == ARRAY_TYPE) {
-            DynamicArray* arr = static_cast<DynamicArray*>(entry->dataPtr);
-            for (int j = 0; j < arr->size; ++j) file << " " << MGET(arr, j);
-        } else if (entry->type == FLIST_TYPE) {
-            SinglyLinkedList* list = static_cast<SinglyLinkedList*>(entry->dataPtr);
-            struct FNode* current = list->head;
-            while(current) { file << " " << current->data; current = current->next; }
-        } else if (entry->type == LLIST_TYPE) {
-            DoublyLinkedList* list = static_cast<DoublyLinkedList*>(entry->dataPtr);
-            struct LNode* current = list->head;
-            while(current) { file << " " << current->data; current = current->next; }
-        } else if (entry->type == STACK_TYPE) {
-            Stack* stack = static_cast<Stack*>(entry->dataPtr);
-            std::function<void(FNode*)> saveRecursive =
-                [&](struct FNode* node) {
-                if (!node) return;
-                saveRecursive(node->next);
-                file << " " << node->data;
-            };
-            saveRecursive(stack->top);
-        } else if (entry->type == QUEUE_TYPE) {
-            Queue* queue = static_cast<Queue*>(entry->dataPtr);
-            struct FNode* current = queue->front;
-            while(current) { file << " " << current->data; current = current->next; }
-        } else if (entry->type == TREE_TYPE) {
-            AVLTree* tree = static_cast<AVLTree*>(entry->dataPtr);
-            std::function<void(TNode*)> saveInorder =
-                [&](struct TNode* node) {
-                if (!node) return;
-                saveInorder(node->left);
-                file << " " << node->data;
-                saveInorder(node->right);
-            };
-            saveInorder(tree->root);
+        // Множество пишется по возрастанию, чтобы --readonly искал в секции двоичным поиском.
+        std::vector<const std::string*> sortedSet;
+        if (entry->type == HSET_TYPE) {
+            auto collect = [&](const std::string& value) { sortedSet.push_back(&value); };
+            visitValues(entry, collect);
+            std::sort(sortedSet.begin(), sortedSet.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
         }
-        file << std::endl;
+        auto visitSection = [&](auto& visit) {
+            if (entry->type != HSET_TYPE) visitValues(entry, visit);
+            else for (const std::string* value : sortedSet) visit(*value);
+        };
+        uint64_t count = 0;
+        auto countValues = [&](const std::string&) { count++; };
+        visitSection(countValues);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        uint64_t position = 0;
+        file.write(reinterpret_cast<const char*>(&position), sizeof(position));
+        auto writeOffset = [&](const std::string& value) {
+            position += value.size();
+            file.write(reinterpret_cast<const char*>(&position), sizeof(position));
+        };
+        visitSection(writeOffset);
+        auto writeValue = [&](const std::string& value) { file.write(value.data(), static_cast<std::streamsize>(value.size())); };
+        visitSection(writeValue);
+        writePadding(file, position);
+    }
+    file.close();
+    if (!file || rename(tempName.c_str(), filename.c_str()) != 0) {
+        std::cerr << "ERROR: Could not write file '" << filename << "'." << std::endl;
+        unlink(tempName.c_str());
+        return false;
     }
+    return true;
 }
 
-void loadFromFile(struct DataStore* store, const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return;
-    destroyStore(store);
+void saveToFile(const struct DataStore* store, const std::string& filename) {
+    if (filename.empty()) return;
+    writeSnapshot(store, filename, filename + ".tmp");
+}
+
+static int64_t currentMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Дочерний процесс пишет снимок из своей копии памяти (copy-on-write), родитель продолжает работу.
+// У ребёнка свой временный файл, чтобы не пересекаться с синхронным saveToFile. Длительность
+// записи ребёнок передаёт через pipe: родитель замечает завершение с опозданием.
+bool startBackgroundSave(struct DataStore* store, const std::string& filename) {
+    if (filename.empty() || store->background.child > 0) return false;
+    int resultPipe[2];
+    if (pipe(resultPipe) < 0) {
+        std::cerr << "ERROR: pipe: " << strerror(errno) << std::endl;
+        return false;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        std::cerr << "ERROR: fork: " << strerror(errno) << std::endl;
+        close(resultPipe[0]);
+        close(resultPipe[1]);
+        return false;
+    }
+    if (child == 0) {
+        close(resultPipe[0]);
+        int64_t startedAt = currentMillis();
+        bool saved = writeSnapshot(store, filename, filename + ".bgsave");
+        int64_t duration = currentMillis() - startedAt;
+        ssize_t written = write(resultPipe[1], &duration, sizeof(duration));
+        _exit(saved && written == static_cast<ssize_t>(sizeof(duration)) ? 0 : 1);
+    }
+    close(resultPipe[1]);
+    store->background.resultFd = resultPipe[0];
+    store->background.child = child;
+    store->background.startedAt = currentMillis();
+    store->background.savedChanges = store->background.pendingChanges;
+    return true;
+}
+
+// Изменения, сделанные после fork, в снимок ребёнка не попали - они остаются в pendingChanges.
+void pollBackgroundSave(struct DataStore* store, const std::string& filename, bool wait) {
+    struct BackgroundSave* background = &store->background;
+    if (background->child <= 0) return;
+    int status = 0;
+    pid_t result = waitpid(background->child, &status, wait ? 0 : WNOHANG);
+    if (result == 0 || (result < 0 && errno == EINTR)) return;
+    bool saved = result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    background->child = 0;
+    background->lastStatus = saved ? SAVE_OK : SAVE_FAILED;
+    int64_t duration = 0;
+    if (saved && read(background->resultFd, &duration, sizeof(duration)) == static_cast<ssize_t>(sizeof(duration))) {
+        background->lastDurationMs = duration;
+    } else {
+        background->lastDurationMs = currentMillis() - background->startedAt;
+    }
+    close(background->resultFd);
+    background->resultFd = -1;
+    if (saved) background->pendingChanges -= background->savedChanges;
+    background->savedChanges = 0;
+    if (!wait) persistChanges(store, filename, 0);
+}
+
+// Вызывается после изменяющих команд вместо saveToFile. Без --autosave файл по-прежнему
+// перезаписывается сразу; пока работает BGSAVE, запись откладывается до его завершения, чтобы
+// более старый снимок ребёнка не лёг поверх нового.
+void persistChanges(struct DataStore* store, const std::string& filename, int changes) {
+    struct BackgroundSave* background = &store->background;
+    background->pendingChanges += changes;
+    pollBackgroundSave(store, filename, false);
+    if (background->child > 0 || background->pendingChanges == 0) return;
+    if (background->autoSaveChanges == 0) {
+        saveToFile(store, filename);
+        background->pendingChanges = 0;
+    } else if (background->pendingChanges >= background->autoSaveChanges) {
+        startBackgroundSave(store, filename);
+    }
+}
+
+// Перед выходом дожидаемся ребёнка и сохраняем то, что он не успел захватить.
+void finishBackgroundSave(struct DataStore* store, const std::string& filename) {
+    pollBackgroundSave(store, filename, true);
+    if (store->background.pendingChanges > 0 && !store->readOnly) {
+        saveToFile(store, filename);
+        store->background.pendingChanges = 0;
+    }
+}
+
+// shardCount == 0 - хранилище без шардов, ему принадлежат все имена.
+static bool ownsName(const std::string& name, int shard, int shardCount) {
+    return shardCount == 0 || shardForName(name, shardCount) == shard;
+}
+
+static void loadTextFile(struct DataStore* store, std::ifstream& file, int shard, int shardCount) {
     std::string line;
     while (std::getline(file, line)) {
         if (line.empty()) continue;
         std::stringstream lineStream(line);
         std::string typeStr, name, value;
         lineStream >> typeStr >> name;
+        if (!ownsName(name, shard, shardCount)) continue;
         if (typeStr == "ARRAY") {
             DynamicArray* arr = static_cast<DynamicArray*>(createAndAddStructure(store, name, ARRAY_TYPE));
             while (lineStream >> value) MPUSH_BACK(arr, value);
@@ -214,4 +618,58 @@ void loadFromFile(struct DataStore* store, const std::string& filename) {
             while (lineStream >> value) TINSERT(tree, value);
         }
     }
-}
\ No newline at end of file
+}
+
+// Регистрирует только имена, принадлежащие шарду shard: чужие записи в его таблицу не попадают,
+// иначе снимок всех шардов вместе (больше MAX_STRUCTURES имён) переполнил бы таблицу одного.
+static void loadStoreFile(struct DataStore* store, const std::string& filename, int shard, int shardCount) {
+    if (!isSnapshotFile(filename)) {
+        if (store->readOnly) {
+            std::cerr << "ERROR: Read-only mode requires a binary snapshot in '" << filename << "'." << std::endl;
+            return;
+        }
+        std::ifstream file(filename);
+        if (!file.is_open()) return;
+        destroyStore(store);
+        loadTextFile(store, file, shard, shardCount);
+        return;
+    }
+    destroyStore(store);
+    if (!openSnapshot(&store->snapshot, filename)) {
+        std::cerr << "ERROR: Snapshot '" << filename << "' is corrupted." << std::endl;
+        return;
+    }
+    const struct SnapshotDirectoryEntry* directory = snapshotDirectory(&store->snapshot);
+    uint32_t entryCount = snapshotEntryCount(&store->snapshot);
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        std::string name(directory[i].name, strnlen(directory[i].name, MAX_NAME_LENGTH));
+        enum StructureType type = static_cast<enum StructureType>(directory[i].type);
+        if (type <= NONE_TYPE || type > VTREE_TYPE) continue;
+        if (!ownsName(name, shard, shardCount)) continue;
+        struct StoreEntry* entry = addEntry(store, name, type);
+        entry->sectionOffset = directory[i].offset;
+        entry->sectionLength = directory[i].length;
+        entry->sectionFlags = directory[i].flags;
+    }
+}
+
+// Структуры из снимка регистрируются заглушками и строятся при первом обращении в findEntry.
+// Старый текстовый формат читается целиком, как раньше.
+void loadFromFile(struct DataStore* store, const std::string& filename) {
+    if (store->shardCount > 0) {
+        // Каждый шард отображает файл сам и регистрирует только свои заглушки.
+        for (int i = 0; i < store->shardCount; ++i) loadStoreFile(&store->shards[i], filename, i, store->shardCount);
+        return;
+    }
+    loadStoreFile(store, filename, 0, 0);
+}
+
+// Писатель подменяет файл через rename, поэтому смена inode означает новый снимок.
+// Проверка выполняется не чаще раза в секунду, чтобы не делать stat на каждую команду.
+void refreshReadOnlyStore(struct DataStore* store, const std::string& filename) {
+    int64_t now = currentMillis();
+    if (now - store->refreshCheckedAt < 1000) return;
+    store->refreshCheckedAt = now;
+    const struct DataStore* probe = store->shardCount > 0 ? &store->shards[0] : store;
+    if (snapshotChanged(&probe->snapshot, filename)) loadFromFile(store, filename);
+}
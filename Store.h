@@ -2,24 +2,111 @@
 #define STORE_H
 
 #include "DataStructures.h"
+#include "Snapshot.h"
+#include <sys/types.h>
 
+// Готовый ответ на PRINT/SCAN структуры. Действителен, пока version записи не изменилась
+// и совпадают формат вывода и страница. Устаревший ответ не освобождается сразу: его память
+// пойдёт под следующий ответ той же структуры. usedAt - для вытеснения самого давнего.
+#ifndef PRINT_CACHE_BUDGET
+#define PRINT_CACHE_BUDGET (64LL << 20)
+#endif
+struct PrintCache {
+    std::string reply;
+    bool valid;
+    uint64_t version;
+    enum OutputFormat format;
+    bool isScan;
+    int64_t offset;
+    int64_t limit;
+    uint64_t usedAt;
+};
+
+// version увеличивается каждой изменяющей командой (markEntryModified).
 struct StoreEntry {
     char name[MAX_NAME_LENGTH];
     enum StructureType type;
     void* dataPtr;
     bool isUsed;
+    bool isLoaded;
+    uint64_t sectionOffset;
+    uint64_t sectionLength;
+    uint32_t sectionFlags;
+    bool sectionChecked;
+    struct OpCounters counters;
+    uint64_t version;
+    struct PrintCache printCache;
+};
+
+enum SaveStatus {
+    SAVE_NONE, SAVE_OK, SAVE_FAILED
+};
+
+// Фоновое сохранение (BGSAVE). autoSaveChanges > 0 - после стольких изменений снимок
+// пишется в фоне, а не синхронно после каждой команды.
+struct BackgroundSave {
+    pid_t child;
+    int resultFd;
+    int64_t startedAt;
+    int64_t lastDurationMs;
+    enum SaveStatus lastStatus;
+    int autoSaveChanges;
+    int pendingChanges;
+    int savedChanges;
+};
+
+// Репликация. У ведущего offset - номер последней изменяющей команды, у ведомого (--replicaof) -
+// номер последней применённой записи потока; leaderTime - метка времени этой записи у ведущего.
+struct ReplicationState {
+    bool follower;
+    std::string leaderPath;
+    int leaderFd;
+    std::string input;
+    uint64_t offset;
+    int64_t leaderTime;
+    int64_t lagMs;
+    int64_t retryAt;
+    int replicaCount;
 };
 
 struct DataStore {
     struct StoreEntry entries[MAX_STRUCTURES];
     int count;
+    struct SnapshotFile snapshot;
+    bool readOnly;
+    int64_t refreshCheckedAt;
+    struct BackgroundSave background;
+    std::string filePath;
+    struct ReplicationState replication;
+    // Режим --shards: структуры распределены по shards[0..shardCount) по хешу имени,
+    // у самого хранилища записей нет, сохранение и загрузка обходят все шарды.
+    struct DataStore* shards;
+    int shardCount;
+    // Все кэши PRINT хранилища (шарда), вместе с устаревшими, занимают не больше PRINT_CACHE_BUDGET байт.
+    uint64_t printCacheClock;
 };
 
 void initializeStore(struct DataStore* store);
+void createShards(struct DataStore* store, int shardCount);
+int shardForName(const std::string& name, int shardCount);
 struct StoreEntry* findEntry(struct DataStore* store, const std::string& name);
+void materializeEntry(struct DataStore* store, struct StoreEntry* entry);
+// Секция записи в снимке. Порядок смещений проверяется при первом обращении к записи, а не на каждый запрос.
+bool entrySectionView(struct DataStore* store, struct StoreEntry* entry, struct SectionView* view);
 void* createAndAddStructure(struct DataStore* store, const std::string& name, enum StructureType type);
 void destroyStore(struct DataStore* store);
 void saveToFile(const struct DataStore* store, const std::string& filename);
+bool startBackgroundSave(struct DataStore* store, const std::string& filename);
+void pollBackgroundSave(struct DataStore* store, const std::string& filename, bool wait);
+void persistChanges(struct DataStore* store, const std::string& filename, int changes);
+void finishBackgroundSave(struct DataStore* store, const std::string& filename);
 void loadFromFile(struct DataStore* store, const std::string& filename);
+void markEntryModified(struct StoreEntry* entry);
+// Возвращает закэшированный ответ или nullptr, если его нет или он устарел.
+const std::string* findPrintCache(struct DataStore* store, struct StoreEntry* entry, enum OutputFormat format, bool isScan, int64_t offset, int64_t limit);
+// Запоминает ответ, вытесняя давно не читанные кэши других структур, чтобы уложиться в бюджет.
+void storePrintCache(struct DataStore* store, struct StoreEntry* entry, enum OutputFormat format, bool isScan, int64_t offset, int64_t limit, std::string&& reply);
+void releasePrintCache(struct StoreEntry* entry);
+void refreshReadOnlyStore(struct DataStore* store, const std::string& filename);
 
 #endif
\ No newline at end of file
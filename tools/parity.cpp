@@ -0,0 +1,360 @@
+// Сравнение реализаций на C++ (main.cpp) и Go (main.go) на одинаковых нагрузках.
+//
+// Сборка и запуск:
+//   g++ -std=c++17 -O2 *.cpp -o store && go build -o gostore main.go
+//   g++ -std=c++17 -O2 tools/parity.cpp -o parity
+//   ./parity --cpp ./store --go ./gostore [--ops N] [--seed S] [--workload NAME]
+//
+// Нагрузки генерируются детерминированно из seed и проигрываются через REPL обеих программ
+// по одной команде: следующая отправляется после приглашения "> ", так что время между ними -
+// задержка команды вместе с сохранением файла. stdin программы - псевдотерминал в raw-режиме:
+// C++-версия сбрасывает вывод на каждом приглашении только в интерактивном режиме.
+// Ответы сравниваются по командам; сообщения об ошибках у реализаций разные, поэтому для stderr
+// сравнивается только число ошибок. PRINT дерева не генерируется (Go рисует дерево, C++ печатает
+// список), а ключи дерева - шестизначные числа: строковый и числовой порядок у них совпадают.
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#define PARITY_DEFAULT_OPS 2000
+#define PARITY_DEFAULT_SEED 1
+#define PARITY_SHOWN_MISMATCHES 5
+#define PARITY_REPLY_TIMEOUT_MS 10000
+
+struct Workload {
+    std::string name;
+    std::vector<std::string> commands;
+};
+
+struct Replay {
+    bool completed;
+    std::vector<std::string> replies;
+    std::vector<int64_t> latenciesNs;
+    int64_t totalNs;
+    int errorCount;
+};
+
+struct Generator {
+    std::mt19937_64 random;
+};
+
+static int randomInt(struct Generator* generator, int from, int to) {
+    return std::uniform_int_distribution<int>(from, to)(generator->random);
+}
+
+static std::string randomValue(struct Generator* generator, int range) {
+    return "v" + std::to_string(randomInt(generator, 0, range - 1));
+}
+
+static std::string randomTreeKey(struct Generator* generator, int range) {
+    return std::to_string(100000 + randomInt(generator, 0, range - 1));
+}
+
+// Стеки и очереди: вперемешку PUSH/POP/PEEK/LENGTH, включая извлечение из пустых.
+static struct Workload makePushPopWorkload(struct Generator* generator, int ops) {
+    struct Workload workload = {"push-pop", {}};
+    const char* names[] = {"s0", "s1", "q0", "q1"};
+    workload.commands.push_back("SCREATE s0");
+    workload.commands.push_back("SCREATE s1");
+    workload.commands.push_back("QCREATE q0");
+    workload.commands.push_back("QCREATE q1");
+    for (int i = 0; i < ops; ++i) {
+        std::string name = names[randomInt(generator, 0, 3)];
+        char kind = name[0] == 's' ? 'S' : 'Q';
+        int choice = randomInt(generator, 0, 9);
+        if (choice < 5) workload.commands.push_back(std::string(1, kind) + "PUSH " + name + " " + randomValue(generator, 1000));
+        else if (choice < 8) workload.commands.push_back(std::string(1, kind) + "POP " + name);
+        else if (choice < 9) workload.commands.push_back(std::string(1, kind) + (kind == 'S' ? "PEAK " : "PEEK ") + name);
+        else workload.commands.push_back(std::string(1, kind) + "LENGTH " + name);
+    }
+    for (const char* name : names) workload.commands.push_back(std::string("PRINT ") + name);
+    return workload;
+}
+
+// Небольшие массив и списки, дальше в основном ISMEMBER (примерно половина - промахи).
+static struct Workload makeMembershipWorkload(struct Generator* generator, int ops) {
+    struct Workload workload = {"membership", {}};
+    const char* names[] = {"m", "f", "l"};
+    workload.commands.push_back("MCREATE m");
+    workload.commands.push_back("FCREATE f");
+    workload.commands.push_back("LCREATE l");
+    for (int i = 0; i < 200; ++i) {
+        workload.commands.push_back("MPUSH_BACK m " + randomValue(generator, 400));
+        workload.commands.push_back("FPUSH_TAIL f " + randomValue(generator, 400));
+        workload.commands.push_back("LPUSH_HEAD l " + randomValue(generator, 400));
+    }
+    for (int i = 0; i < ops; ++i) {
+        std::string name = names[randomInt(generator, 0, 2)];
+        if (randomInt(generator, 0, 19) == 0) {
+            workload.commands.push_back(name == "m" ? "MSET_AT m " + std::to_string(randomInt(generator, 0, 199)) + " " + randomValue(generator, 400)
+                                                    : (name == "f" ? "FPUSH_HEAD f " : "LPUSH_TAIL l ") + randomValue(generator, 400));
+        } else {
+            workload.commands.push_back("ISMEMBER " + name + " " + randomValue(generator, 400));
+        }
+    }
+    for (const char* name : names) workload.commands.push_back(std::string("PRINT ") + name);
+    return workload;
+}
+
+// АВЛ-дерево: вставки, удаления (в том числе отсутствующих ключей) и поиск.
+static struct Workload makeTreeWorkload(struct Generator* generator, int ops) {
+    struct Workload workload = {"tree", {}};
+    const int range = std::max(100, ops / 2);
+    workload.commands.push_back("TCREATE t");
+    for (int i = 0; i < ops; ++i) {
+        int choice = randomInt(generator, 0, 9);
+        std::string key = randomTreeKey(generator, range);
+        if (choice < 5) workload.commands.push_back("TINSERT t " + key);
+        else if (choice < 7) workload.commands.push_back("TDEL t " + key);
+        else workload.commands.push_back("ISMEMBER t " + key);
+    }
+    for (int i = 0; i < 200; ++i) workload.commands.push_back("ISMEMBER t " + randomTreeKey(generator, range));
+    return workload;
+}
+
+// Массовая загрузка: растущие массив и списки, вставки по индексу, затем полный вывод.
+static struct Workload makeBulkLoadWorkload(struct Generator* generator, int ops) {
+    struct Workload workload = {"bulk-load", {}};
+    workload.commands.push_back("MCREATE m");
+    workload.commands.push_back("FCREATE f");
+    workload.commands.push_back("LCREATE l");
+    int arrayLength = 0;
+    for (int i = 0; i < ops; ++i) {
+        int choice = randomInt(generator, 0, 9);
+        std::string value = randomValue(generator, 1000000);
+        if (choice < 4) {
+            workload.commands.push_back("MPUSH_BACK m " + value);
+            arrayLength++;
+        } else if (choice < 5 && arrayLength > 0) {
+            workload.commands.push_back("MINSERT_AT m " + std::to_string(randomInt(generator, 0, arrayLength)) + " " + value);
+            arrayLength++;
+        } else if (choice < 7) {
+            workload.commands.push_back("FPUSH_TAIL f " + value);
+        } else {
+            workload.commands.push_back("LPUSH_TAIL l " + value);
+        }
+    }
+    workload.commands.push_back("MLENGTH m");
+    workload.commands.push_back("PRINT m");
+    workload.commands.push_back("PRINT f");
+    workload.commands.push_back("PRINT l");
+    return workload;
+}
+
+static bool endsWithPrompt(const std::string& buffer) {
+    return buffer.size() >= 2 && buffer.compare(buffer.size() - 2, 2, "> ") == 0 && (buffer.size() == 2 || buffer[buffer.size() - 3] == '\n');
+}
+
+// Читает вывод до следующего приглашения; reply - всё, что было перед ним.
+static bool readUntilPrompt(int fd, std::string* reply) {
+    std::string buffer;
+    char chunk[65536];
+    while (!endsWithPrompt(buffer)) {
+        struct pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, PARITY_REPLY_TIMEOUT_MS) == 0) {
+            std::cerr << "ERROR: No prompt within " << PARITY_REPLY_TIMEOUT_MS << " ms." << std::endl;
+            return false;
+        }
+        ssize_t received = read(fd, chunk, sizeof(chunk));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+    buffer.resize(buffer.size() - 2);
+    *reply = std::move(buffer);
+    return true;
+}
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        written += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+static int countErrorLines(const std::string& errorPath) {
+    std::ifstream file(errorPath);
+    std::string line;
+    int count = 0;
+    while (std::getline(file, line)) {
+        if (line.rfind("ERROR", 0) == 0) count++;
+    }
+    return count;
+}
+
+static struct Replay replayWorkload(const std::string& binary, const struct Workload& workload, const std::string& directory) {
+    struct Replay replay = {false, {}, {}, 0, 0};
+    std::string dataPath = directory + "/store.dat";
+    std::string errorPath = directory + "/stderr.txt";
+    unlink(dataPath.c_str());
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        std::cerr << "ERROR: Could not open a pseudo-terminal: " << strerror(errno) << std::endl;
+        return replay;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    struct termios mode;
+    tcgetattr(slave, &mode);
+    cfmakeraw(&mode);
+    tcsetattr(slave, TCSANOW, &mode);
+    int outputPipe[2];
+    if (slave < 0 || pipe(outputPipe) != 0) {
+        std::cerr << "ERROR: Could not set up pipes: " << strerror(errno) << std::endl;
+        close(master);
+        return replay;
+    }
+    int errorFd = open(errorPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    pid_t child = fork();
+    if (child == 0) {
+        dup2(slave, STDIN_FILENO);
+        dup2(outputPipe[1], STDOUT_FILENO);
+        dup2(errorFd, STDERR_FILENO);
+        close(master);
+        close(slave);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        close(errorFd);
+        execl(binary.c_str(), binary.c_str(), "--file", dataPath.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(slave);
+    close(outputPipe[1]);
+    close(errorFd);
+
+    std::string reply;
+    // C++-версия печатает справку перед первым приглашением.
+    bool alive = child > 0 && readUntilPrompt(outputPipe[0], &reply);
+    auto startedAt = std::chrono::steady_clock::now();
+    for (size_t i = 0; alive && i < workload.commands.size(); ++i) {
+        auto sentAt = std::chrono::steady_clock::now();
+        alive = writeAll(master, workload.commands[i] + "\n") && readUntilPrompt(outputPipe[0], &reply);
+        if (!alive) break;
+        replay.latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sentAt).count());
+        replay.replies.push_back(std::move(reply));
+    }
+    replay.totalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startedAt).count();
+    replay.completed = alive;
+
+    writeAll(master, "QUIT\n");
+    close(master);
+    close(outputPipe[0]);
+    if (child > 0) waitpid(child, nullptr, 0);
+    replay.errorCount = countErrorLines(errorPath);
+    unlink(dataPath.c_str());
+    unlink(errorPath.c_str());
+    return replay;
+}
+
+static int64_t percentile(std::vector<int64_t> values, double fraction) {
+    if (values.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+static void printReplayRow(const std::string& workload, const std::string& implementation, const struct Replay& replay) {
+    double seconds = static_cast<double>(replay.totalNs) / 1e9;
+    std::cout << std::left << std::setw(12) << workload << std::setw(6) << implementation << std::right
+              << std::setw(8) << replay.replies.size()
+              << std::setw(11) << std::fixed << std::setprecision(1) << seconds * 1000.0
+              << std::setw(11) << std::setprecision(0) << (seconds > 0 ? static_cast<double>(replay.replies.size()) / seconds : 0.0)
+              << std::setw(10) << percentile(replay.latenciesNs, 0.5) / 1000
+              << std::setw(10) << percentile(replay.latenciesNs, 0.99) / 1000
+              << std::setw(10) << (replay.latenciesNs.empty() ? 0 : *std::max_element(replay.latenciesNs.begin(), replay.latenciesNs.end()) / 1000)
+              << std::setw(8) << replay.errorCount << "\n";
+}
+
+// Возвращает число расхождений и печатает первые из них.
+static int compareReplays(const struct Workload& workload, const struct Replay& cpp, const struct Replay& go) {
+    int mismatches = 0;
+    size_t count = std::min(cpp.replies.size(), go.replies.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (cpp.replies[i] == go.replies[i]) continue;
+        if (++mismatches <= PARITY_SHOWN_MISMATCHES) {
+            std::cout << "  mismatch #" << i << " '" << workload.commands[i] << "': C++ '" << cpp.replies[i].substr(0, 80)
+                      << "' vs Go '" << go.replies[i].substr(0, 80) << "'\n";
+        }
+    }
+    if (cpp.replies.size() != go.replies.size()) {
+        std::cout << "  replies: C++ " << cpp.replies.size() << " vs Go " << go.replies.size() << "\n";
+        mismatches++;
+    }
+    if (cpp.errorCount != go.errorCount) {
+        std::cout << "  errors: C++ " << cpp.errorCount << " vs Go " << go.errorCount << "\n";
+        mismatches++;
+    }
+    return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+    std::string cppBinary, goBinary, only;
+    int ops = PARITY_DEFAULT_OPS;
+    uint64_t seed = PARITY_DEFAULT_SEED;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--cpp" && i + 1 < argc) cppBinary = argv[++i];
+        else if (arg == "--go" && i + 1 < argc) goBinary = argv[++i];
+        else if (arg == "--ops" && i + 1 < argc) ops = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--workload" && i + 1 < argc) only = argv[++i];
+    }
+    if (cppBinary.empty() || goBinary.empty()) {
+        std::cerr << "Usage: parity --cpp <binary> --go <binary> [--ops N] [--seed S] [--workload push-pop|membership|tree|bulk-load]\n";
+        return 2;
+    }
+
+    char directoryTemplate[] = "/tmp/parityXXXXXX";
+    if (!mkdtemp(directoryTemplate)) {
+        std::cerr << "ERROR: mkdtemp: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string directory = directoryTemplate;
+
+    struct Generator generator;
+    generator.random.seed(seed);
+    std::vector<struct Workload> workloads;
+    workloads.push_back(makePushPopWorkload(&generator, ops));
+    workloads.push_back(makeMembershipWorkload(&generator, ops));
+    workloads.push_back(makeTreeWorkload(&generator, ops));
+    workloads.push_back(makeBulkLoadWorkload(&generator, ops));
+
+    std::cout << "seed " << seed << ", " << ops << " ops per workload; latency in microseconds\n";
+    std::cout << std::left << std::setw(12) << "workload" << std::setw(6) << "impl" << std::right << std::setw(8) << "cmds"
+              << std::setw(11) << "total ms" << std::setw(11) << "ops/s" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "max" << std::setw(8) << "errors" << "\n";
+    int failures = 0;
+    for (const struct Workload& workload : workloads) {
+        if (!only.empty() && workload.name != only) continue;
+        struct Replay cpp = replayWorkload(cppBinary, workload, directory);
+        struct Replay go = replayWorkload(goBinary, workload, directory);
+        printReplayRow(workload.name, "C++", cpp);
+        printReplayRow(workload.name, "Go", go);
+        int mismatches = compareReplays(workload, cpp, go);
+        if (!cpp.completed || !go.completed) std::cout << "  replay stopped early: the store exited\n";
+        std::cout << "  " << (mismatches == 0 && cpp.completed && go.completed ? "outputs agree" : "OUTPUTS DIFFER") << "\n";
+        if (mismatches != 0 || !cpp.completed || !go.completed) failures++;
+    }
+    rmdir(directory.c_str());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// Проверка загрузки снимка в режиме --shards: вместе шарды хранят больше MAX_STRUCTURES структур,
+// и после перезапуска (и обновления --readonly) каждая должна найтись в своём шарде.
+//
+// Сборка и запуск (из корня репозитория):
+//   g++ -std=c++17 -O2 -pthread -I. tools/shardreload.cpp $(ls *.cpp | grep -v main.cpp) -o shardreload
+//   ./shardreload [--file PATH]
+//
+// Код возврата 0 - все структуры на месте, 1 - что-то потерялось или загрузка упала.
+#include "Store.h"
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#define SHARDRELOAD_SHARDS 4
+#define SHARDRELOAD_FIRST_COUNT (MAX_STRUCTURES * 3 / 2)
+#define SHARDRELOAD_SECOND_COUNT (MAX_STRUCTURES * 2)
+
+static std::string structureName(int index) {
+    return "s" + std::to_string(index);
+}
+
+// Структура i - массив из одного значения v<i>, создаётся в шарде, которому принадлежит имя.
+static void fillShards(struct DataStore* store, int count) {
+    for (int i = 0; i < count; ++i) {
+        std::string name = structureName(i);
+        struct DataStore* shard = &store->shards[shardForName(name, store->shardCount)];
+        if (findEntry(shard, name) != nullptr) continue;
+        DynamicArray* array = static_cast<DynamicArray*>(createAndAddStructure(shard, name, ARRAY_TYPE));
+        MPUSH_BACK(array, "v" + std::to_string(i));
+    }
+}
+
+// В режиме --readonly записи не строятся, значение читается прямо из секции снимка.
+static bool hasStructure(struct DataStore* shard, const std::string& name, const std::string& value) {
+    struct StoreEntry* entry = findEntry(shard, name);
+    if (entry == nullptr || entry->type != ARRAY_TYPE) return false;
+    if (!entry->isLoaded) {
+        struct SectionView view;
+        return entrySectionView(shard, entry, &view) && view.count == 1 && sectionValue(&view, 0) == value;
+    }
+    const DynamicArray* array = static_cast<const DynamicArray*>(entry->dataPtr);
+    return array->size == 1 && array->elements[0] == value;
+}
+
+static bool checkShards(struct DataStore* store, int count, const char* stage) {
+    int total = 0;
+    for (int i = 0; i < store->shardCount; ++i) total += store->shards[i].count;
+    if (total != count) {
+        std::cerr << stage << ": " << total << " structures loaded, expected " << count << "\n";
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        std::string name = structureName(i);
+        if (!hasStructure(&store->shards[shardForName(name, store->shardCount)], name, "v" + std::to_string(i))) {
+            std::cerr << stage << ": structure '" << name << "' is missing or wrong\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static void openShards(struct DataStore* store, bool readOnly) {
+    initializeStore(store);
+    store->readOnly = readOnly;
+    createShards(store, SHARDRELOAD_SHARDS);
+}
+
+static bool run(const std::string& path) {
+    struct DataStore writer;
+    openShards(&writer, false);
+    fillShards(&writer, SHARDRELOAD_FIRST_COUNT);
+    saveToFile(&writer, path);
+
+    struct DataStore restarted;
+    openShards(&restarted, false);
+    loadFromFile(&restarted, path);
+    if (!checkShards(&restarted, SHARDRELOAD_FIRST_COUNT, "restart")) return false;
+
+    struct DataStore reader;
+    openShards(&reader, true);
+    loadFromFile(&reader, path);
+    if (!checkShards(&reader, SHARDRELOAD_FIRST_COUNT, "readonly")) return false;
+
+    // Новый снимок приходит через rename; проверка раз в секунду обходится сдвигом времени проверки.
+    fillShards(&writer, SHARDRELOAD_SECOND_COUNT);
+    saveToFile(&writer, path);
+    reader.refreshCheckedAt = -1000000;
+    refreshReadOnlyStore(&reader, path);
+    return checkShards(&reader, SHARDRELOAD_SECOND_COUNT, "readonly refresh");
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = "shardreload.db";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--file" && i + 1 < argc) path = argv[++i];
+    }
+    bool passed = false;
+    try {
+        passed = run(path);
+    } catch (const std::exception& error) {
+        std::cerr << "ERROR: " << error.what() << "\n";
+    }
+    std::remove(path.c_str());
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
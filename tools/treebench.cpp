@@ -0,0 +1,191 @@
+// Замер операций упорядоченных структур (АВЛ-дерево TREE и B+-дерево BTREE) напрямую через их API,
+// без разбора команд и вывода.
+//
+// Сборка и запуск (из корня репозитория):
+//   g++ -std=c++17 -O2 -pthread -I. tools/treebench.cpp $(ls *.cpp | grep -v main.cpp) -o treebench
+//   ./treebench [--keys N] [--lookups M] [--key-length L] [--seed S] [--structure tree|btree|all]
+//
+// Ключи - случайные строки из [a-z0-9] длины key-length, порождаются из seed, поэтому прогоны
+// с одинаковыми параметрами сравнимы между сборками. Фазы:
+//   insert - xINSERT всех ключей в пустое дерево;
+//   find-hit / find-miss - xIS_MEMBER для вставленных ключей в случайном порядке и для новых;
+//   range - страница PRINT (xPRINT_PAGE) по BENCH_RANGE_LIMIT элементов со случайного номера;
+//   delete - xDEL половины ключей.
+// Для каждой фазы печатается время на операцию у каждой структуры, при обеих - ещё отношение
+// BTREE / TREE; found - число найденных ключей, одинаковое у всех структур и сборок. Чтобы
+// сравнить раскладку узлов, программа собирается так же из исходников коммита до изменения и после.
+#include "DataStructures.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define BENCH_DEFAULT_KEYS 1000000
+#define BENCH_DEFAULT_LOOKUPS 1000000
+#define BENCH_DEFAULT_KEY_LENGTH 24
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_RANGES 20000
+#define BENCH_RANGE_LIMIT 100
+
+struct BenchConfig {
+    int64_t keys;
+    int64_t lookups;
+    int keyLength;
+    uint64_t seed;
+};
+
+static std::vector<std::string> randomKeys(std::mt19937_64* random, int64_t count, int length) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(sizeof(alphabet)) - 2);
+    std::vector<std::string> keys(static_cast<size_t>(count));
+    for (std::string& key : keys) {
+        key.resize(static_cast<size_t>(length));
+        for (char& c : key) c = alphabet[pick(*random)];
+    }
+    return keys;
+}
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Операции структуры для общего прогона: одинаковые ключи и фазы для TREE и BTREE.
+struct TreeOps {
+    typedef struct AVLTree Tree;
+    static const char* name() { return "TREE"; }
+    static void create(Tree* tree) { TCREATE(tree); }
+    static void destroy(Tree* tree) { TDESTROY(tree); }
+    static void insert(Tree* tree, const std::string& key) { TINSERT(tree, key); }
+    static bool contains(const Tree* tree, const std::string& key) { return TIS_MEMBER(tree, key); }
+    static bool remove(Tree* tree, const std::string& key) { return TDEL(tree, key); }
+    static int64_t length(const Tree* tree) { return TLENGTH(tree); }
+    static void page(const Tree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out) { TPRINT_PAGE(tree, offset, limit, out); }
+};
+
+struct BTreeOps {
+    typedef struct BPlusTree Tree;
+    static const char* name() { return "BTREE"; }
+    static void create(Tree* tree) { BCREATE(tree); }
+    static void destroy(Tree* tree) { BDESTROY(tree); }
+    static void insert(Tree* tree, const std::string& key) { BINSERT(tree, key); }
+    static bool contains(const Tree* tree, const std::string& key) { return BIS_MEMBER(tree, key); }
+    static bool remove(Tree* tree, const std::string& key) { return BDEL(tree, key); }
+    static int64_t length(const Tree* tree) { return BLENGTH(tree); }
+    static void page(const Tree* tree, int64_t offset, int64_t limit, struct OutputBuffer* out) { BPRINT_PAGE(tree, offset, limit, out); }
+};
+
+enum BenchPhase {
+    PHASE_INSERT, PHASE_FIND_HIT, PHASE_FIND_MISS, PHASE_RANGE, PHASE_DELETE, PHASE_COUNT
+};
+
+static const char* const phaseNames[PHASE_COUNT] = {"insert", "find-hit", "find-miss", "range", "delete"};
+
+struct PhaseResult {
+    double nsPerOperation;
+    int64_t found;
+};
+
+static struct PhaseResult finishPhase(int64_t startedNs, int64_t operations, int64_t found) {
+    double elapsed = static_cast<double>(nowNs() - startedNs);
+    return {operations > 0 ? elapsed / static_cast<double>(operations) : 0, found};
+}
+
+// Ключи порождаются заново из seed, поэтому у всех структур они одинаковые.
+template <typename Ops>
+static std::vector<struct PhaseResult> benchStructure(const struct BenchConfig* config) {
+    std::mt19937_64 random(config->seed);
+    std::vector<std::string> keys = randomKeys(&random, config->keys, config->keyLength);
+    std::vector<std::string> misses = randomKeys(&random, config->lookups, config->keyLength);
+    std::vector<std::string> probes(static_cast<size_t>(config->lookups));
+    for (std::string& probe : probes) probe = keys[std::uniform_int_distribution<size_t>(0, keys.size() - 1)(random)];
+    std::vector<struct PhaseResult> results(PHASE_COUNT);
+    struct OutputBuffer out;
+    initOutput(&out, -1, COMPACT_FORMAT);
+
+    typename Ops::Tree tree;
+    Ops::create(&tree);
+    int64_t started = nowNs();
+    for (const std::string& key : keys) Ops::insert(&tree, key);
+    results[PHASE_INSERT] = finishPhase(started, config->keys, Ops::length(&tree));
+
+    int64_t found = 0;
+    started = nowNs();
+    for (const std::string& probe : probes) found += Ops::contains(&tree, probe);
+    results[PHASE_FIND_HIT] = finishPhase(started, config->lookups, found);
+
+    found = 0;
+    started = nowNs();
+    for (const std::string& probe : misses) found += Ops::contains(&tree, probe);
+    results[PHASE_FIND_MISS] = finishPhase(started, config->lookups, found);
+
+    int64_t length = Ops::length(&tree);
+    started = nowNs();
+    for (int i = 0; i < BENCH_RANGES; ++i) {
+        out.length = 0;
+        Ops::page(&tree, std::uniform_int_distribution<int64_t>(0, length - 1)(random), BENCH_RANGE_LIMIT, &out);
+    }
+    results[PHASE_RANGE] = finishPhase(started, BENCH_RANGES, BENCH_RANGES);
+
+    found = 0;
+    started = nowNs();
+    for (size_t i = 0; i < keys.size(); i += 2) found += Ops::remove(&tree, keys[i]);
+    results[PHASE_DELETE] = finishPhase(started, (config->keys + 1) / 2, found);
+    Ops::destroy(&tree);
+    out.length = 0;
+    destroyOutput(&out);
+    return results;
+}
+
+// Столбец на структуру; при двух структурах последний столбец - BTREE / TREE по времени.
+static void printResults(const std::vector<const char*>& names, const std::vector<std::vector<struct PhaseResult>>& results) {
+    std::cout << std::left << std::setw(12) << "ns/op" << std::right;
+    for (const char* name : names) std::cout << std::setw(12) << name;
+    if (results.size() == 2) std::cout << std::setw(12) << "ratio";
+    std::cout << std::setw(12) << "found" << "\n";
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        std::cout << std::left << std::setw(12) << phaseNames[phase] << std::right << std::fixed;
+        for (const std::vector<struct PhaseResult>& result : results) std::cout << std::setw(12) << std::setprecision(1) << result[phase].nsPerOperation;
+        if (results.size() == 2) std::cout << std::setw(12) << std::setprecision(2) << results[1][phase].nsPerOperation / results[0][phase].nsPerOperation;
+        std::cout << std::setw(12) << results[0][phase].found << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    struct BenchConfig config = {BENCH_DEFAULT_KEYS, BENCH_DEFAULT_LOOKUPS, BENCH_DEFAULT_KEY_LENGTH, BENCH_DEFAULT_SEED};
+    std::string structure = "all";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--keys") config.keys = std::max(1LL, std::atoll(argv[i + 1]));
+        else if (arg == "--lookups") config.lookups = std::max(1LL, std::atoll(argv[i + 1]));
+        else if (arg == "--key-length") config.keyLength = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "--seed") config.seed = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (arg == "--structure") structure = argv[i + 1];
+        else {
+            std::cerr << "Unknown option '" << arg << "'.\n";
+            return 1;
+        }
+    }
+    if (structure != "all" && structure != "tree" && structure != "btree") {
+        std::cerr << "Unknown structure '" << structure << "'.\n";
+        return 1;
+    }
+    std::vector<const char*> names;
+    std::vector<std::vector<struct PhaseResult>> results;
+    if (structure != "btree") {
+        names.push_back(TreeOps::name());
+        results.push_back(benchStructure<TreeOps>(&config));
+    }
+    if (structure != "tree") {
+        names.push_back(BTreeOps::name());
+        results.push_back(benchStructure<BTreeOps>(&config));
+    }
+    std::cout << config.keys << " keys of " << config.keyLength << " bytes, " << config.lookups << " lookups\n";
+    printResults(names, results);
+    return 0;
+}